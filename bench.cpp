@@ -0,0 +1,121 @@
+/* Throughput benchmark of one producer and one consumer, with hardware counters per message.
+
+ALIGN_NO_FALSE_SHARING, the implementation and the slot layout (RING_BENCH_FLAGS, RingBufFlags
+such as RING_BUF_STAMP32) are compile-time choices, so build one binary per combination and
+compare their tables; CMakeLists.txt builds the sweep as bench_<impl>_<align>_<layout>, e.g.
+  g++ -std=c++17 -O2 -pthread bench.cpp -o bench_spsc_128
+  g++ -std=c++17 -O2 -pthread -DRING_BENCH_MPSC -DALIGN_NO_FALSE_SHARING=64 bench.cpp -o bench_mpsc_64
+  g++ -std=c++17 -O2 -pthread -DRING_BENCH_FLAGS=RING_BUF_STAMP32 bench.cpp -o bench_spsc_128_stamp32
+Usage: bench [messages] [producer cpu] [consumer cpu]
+
+Each row is one (payload size, version_granularity) configuration. Counter columns are per
+message, summed over the producer and consumer threads; "-" means the event could not be
+opened (see perf_counters.hpp).
+*/
+#ifdef RING_BENCH_MPSC
+#include "mpsc.cpp"
+#define RING_BENCH_IMPL "mpsc"
+#else
+#include "spsc.cpp"
+#define RING_BENCH_IMPL "spsc"
+#endif
+#ifndef RING_BENCH_FLAGS
+#define RING_BENCH_FLAGS 0
+#endif
+#include "bench.hpp"
+#include "perf_counters.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+
+static constexpr unsigned bench_length = 4096;
+
+struct BenchArgs {
+  uint64_t messages = 10'000'000;
+  int producer_cpu = 0;
+  int consumer_cpu = 1;
+};
+
+template<unsigned payload_size, unsigned version_granularity>
+void run_config(const BenchArgs& args) {
+  using Message = BenchMessage<payload_size>;
+  using Ring = RingBuf<Message, bench_length, version_granularity, RING_BENCH_FLAGS>;
+  std::unique_ptr<Ring> ring(new Ring());
+  BenchFlowControl flow;
+  BenchStartLine start_line;
+  double counter_totals[PerfCounters::num_events] = {};
+  bool counter_available[PerfCounters::num_events] = {};
+  uint64_t start_ns = 0, end_ns = 0;
+  bool in_order = true;
+
+  std::thread producer([&] {
+    bench_pin_to_cpu(args.producer_cpu);
+    PerfCounters counters;
+    Message message{};
+    start_line.arrive_and_wait(2);
+    counters.start();
+    for (uint64_t i = 1; i <= args.messages; ++i) {
+      flow.wait_for_room(i, bench_length / 2);
+      message.seq = i;
+      ring->write(&message);
+    }
+    counters.stop();
+    for (unsigned e = 0; e < PerfCounters::num_events; ++e) {
+      counter_totals[e] += counters.values[e];
+      counter_available[e] = counters.available((PerfCounters::Event)e);
+    }
+  });
+
+  bench_pin_to_cpu(args.consumer_cpu);
+  {
+    PerfCounters counters;
+    Message message;
+    start_line.arrive_and_wait(2);
+    counters.start();
+    start_ns = bench_now_ns();
+    for (uint64_t consumed = 0; consumed < args.messages;) {
+      if (!ring->read(&message)) { continue; }
+      in_order &= message.seq == ++consumed;
+      flow.publish(consumed);
+    }
+    end_ns = bench_now_ns();
+    counters.stop();
+    producer.join(); // the producer has added its counters by now
+    for (unsigned e = 0; e < PerfCounters::num_events; ++e) {
+      counter_totals[e] += counters.values[e];
+      counter_available[e] &= counters.available((PerfCounters::Event)e);
+    }
+  }
+
+  const double ns_per_message = (double)(end_ns - start_ns) / args.messages;
+  std::printf("%s\t%u\t%#x\t%u\t%zu\t%u\t%.2f\t%.2f", RING_BENCH_IMPL, (unsigned)ALIGN_NO_FALSE_SHARING, (unsigned)RING_BENCH_FLAGS,
+    payload_size, sizeof(typename Ring::versioned_DataType), version_granularity, ns_per_message, 1e3 / ns_per_message);
+  for (unsigned e = 0; e < PerfCounters::num_events; ++e) {
+    if (counter_available[e]) { std::printf("\t%.3f", counter_totals[e] / args.messages); }
+    else { std::printf("\t-"); }
+  }
+  std::printf("%s\n", in_order ? "" : "\tOUT OF ORDER");
+}
+
+template<unsigned payload_size>
+void run_granularities(const BenchArgs& args) {
+  run_config<payload_size, 1>(args);
+  run_config<payload_size, 8>(args);
+  run_config<payload_size, 64>(args);
+  run_config<payload_size, bench_length>(args);
+}
+
+int main(int argc, char** argv) {
+  BenchArgs args;
+  if (argc > 1) { args.messages = std::strtoull(argv[1], nullptr, 0); }
+  if (argc > 2) { args.producer_cpu = std::atoi(argv[2]); }
+  if (argc > 3) { args.consumer_cpu = std::atoi(argv[3]); }
+
+  std::printf("impl\talign\tflags\tpayload\tslot\tgranularity\tns/msg\tMmsg/s");
+  for (const char* name : PerfCounters::event_names) { std::printf("\t%s/msg", name); }
+  std::printf("\n");
+  run_granularities<16>(args);
+  run_granularities<64>(args);
+  run_granularities<256>(args);
+  return 0;
+}
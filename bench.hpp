@@ -0,0 +1,77 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <pthread.h>
+#include <sched.h>
+#include <thread>
+#include "ring_buf.hpp"
+
+/* Helpers shared by the benchmarks. The benchmarks include spsc.cpp or mpsc.cpp themselves,
+so this header only depends on the RingBuf declaration.
+*/
+
+inline uint64_t bench_now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline void bench_cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#endif
+}
+
+inline unsigned bench_num_cpus() {
+  unsigned n = std::thread::hardware_concurrency();
+  return n ? n : 1;
+}
+
+// pins the calling thread; a negative cpu leaves it unpinned
+inline bool bench_pin_to_cpu(int cpu) {
+  if (cpu < 0) { return true; }
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu % bench_num_cpus(), &set);
+  return !pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+template<unsigned size>
+struct BenchMessage {
+  static_assert(size >= 16, "a benchmark message carries at least a sequence number and a producer id");
+  uint64_t seq;
+  uint64_t producer;
+  unsigned char pad[size - 16];
+};
+
+/* RingBuf does not check for overflow, so the benchmarks keep producers at most window entries
+ahead of the consumer. The consumer publishes its progress every publish_every reads to keep
+this cache line mostly read-only for the producers.
+*/
+struct alignas(ALIGN_NO_FALSE_SHARING) BenchFlowControl {
+  static constexpr uint64_t publish_every = 64;
+  std::atomic<uint64_t> consumed{0};
+  alignas(ALIGN_NO_FALSE_SHARING) std::atomic<uint64_t> credits_taken{0}; // see take_credit()
+
+  void wait_for_room(uint64_t written, uint64_t window) const {
+    while (written - consumed.load(std::memory_order_acquire) >= window) { bench_cpu_relax(); }
+  }
+  /* For several producers: each write first takes a numbered credit, so that the window holds
+  however many producers pass the check at once (checking the write sequence number instead lets
+  all of them overshoot it together). A credit that is taken must be used for a write.
+  */
+  void take_credit(uint64_t window) {
+    wait_for_room(credits_taken.fetch_add(1, std::memory_order_relaxed) + 1, window);
+  }
+  void publish(uint64_t total_consumed) {
+    if (!(total_consumed & (publish_every - 1))) { consumed.store(total_consumed, std::memory_order_release); }
+  }
+};
+
+// spins until every participant has arrived
+struct BenchStartLine {
+  std::atomic<unsigned> arrived{0};
+  void arrive_and_wait(unsigned participants) {
+    arrived.fetch_add(1, std::memory_order_acq_rel);
+    while (arrived.load(std::memory_order_acquire) < participants) { bench_cpu_relax(); }
+  }
+};
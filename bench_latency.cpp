@@ -0,0 +1,125 @@
+/* Open-loop latency benchmark: producers emit at a fixed aggregate rate and every message carries
+the time it was *supposed* to be sent. The consumer records now - intended send time, so when a
+producer falls behind schedule (ring full, preempted, slow write) the messages queued up behind
+it are charged for the wait instead of silently not being sent, i.e., the numbers are free of
+coordinated omission. This is the latency an SLO on the channel is defined against.
+  g++ -std=c++17 -O2 -pthread bench_latency.cpp -o bench_latency
+  g++ -std=c++17 -O2 -pthread -DRING_BENCH_MPSC bench_latency.cpp -o bench_latency_mpsc
+Usage: bench_latency [messages/s] [seconds] [producers] [consumer cpu] [slo quantile] [slo ns]
+With an SLO (e.g. 0.999 2000) the exit status is non-zero when the measured quantile exceeds it.
+Producer p is pinned to consumer cpu + 1 + p. The SPSC build requires a single producer.
+*/
+#ifdef RING_BENCH_MPSC
+#include "mpsc.cpp"
+#else
+#include "spsc.cpp"
+#endif
+#include "bench.hpp"
+#include "hdr_histogram.hpp"
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+static constexpr unsigned bench_length = 1 << 14;
+static constexpr unsigned bench_granularity = 64;
+static constexpr uint64_t warmup_ns = 100'000'000; // not recorded
+
+struct LatencyMessage {
+  uint64_t intended_send_ns;
+  uint64_t producer;
+};
+
+using LatencyRing = RingBuf<LatencyMessage, bench_length, bench_granularity>;
+
+struct LatencyArgs {
+  double rate = 1e6;
+  double seconds = 5;
+  unsigned producers = 1;
+  int consumer_cpu = 0;
+  double slo_quantile = 0;
+  uint64_t slo_ns = 0;
+};
+
+// the SPSC producer knows how much it wrote; MPSC producers take credits so they cannot overshoot together
+static void wait_for_room(BenchFlowControl& flow, uint64_t locally_written) {
+#ifdef RING_BENCH_MPSC
+  (void)locally_written;
+  flow.take_credit(bench_length / 2);
+#else
+  flow.wait_for_room(locally_written, bench_length / 2);
+#endif
+}
+
+int main(int argc, char** argv) {
+  LatencyArgs args;
+  if (argc > 1) { args.rate = std::atof(argv[1]); }
+  if (argc > 2) { args.seconds = std::atof(argv[2]); }
+  if (argc > 3) { args.producers = (unsigned)std::atoi(argv[3]); }
+  if (argc > 4) { args.consumer_cpu = std::atoi(argv[4]); }
+  if (argc > 6) { args.slo_quantile = std::atof(argv[5]); args.slo_ns = std::strtoull(argv[6], nullptr, 0); }
+#ifndef RING_BENCH_MPSC
+  if (args.producers != 1) {
+    std::fprintf(stderr, "the SPSC build supports exactly one producer, build with -DRING_BENCH_MPSC\n");
+    return 2;
+  }
+#endif
+  if (!args.producers || args.rate <= 0) { return 2; }
+
+  std::unique_ptr<LatencyRing> ring(new LatencyRing());
+  std::unique_ptr<LogLinearHistogram<>> histogram(new LogLinearHistogram<>());
+  BenchFlowControl flow;
+  BenchStartLine start_line;
+  const double interval_ns = 1e9 * args.producers / args.rate; // per producer
+  const uint64_t messages_per_producer = (uint64_t)(args.rate * args.seconds / args.producers);
+  std::atomic<uint64_t> start_ns{0};
+  std::vector<std::thread> threads;
+
+  for (unsigned p = 0; p < args.producers; ++p) {
+    threads.emplace_back([&, p] {
+      bench_pin_to_cpu(args.consumer_cpu + 1 + (int)p);
+      start_line.arrive_and_wait(args.producers + 1);
+      uint64_t start;
+      while (!(start = start_ns.load(std::memory_order_acquire))) { bench_cpu_relax(); }
+      // stagger producers across the interval so the aggregate stream is evenly spaced
+      const double offset_ns = interval_ns * p / args.producers;
+      LatencyMessage message{0, p};
+      for (uint64_t i = 0; i < messages_per_producer; ++i) {
+        message.intended_send_ns = start + (uint64_t)(offset_ns + i * interval_ns);
+        while (bench_now_ns() < message.intended_send_ns) { bench_cpu_relax(); }
+        wait_for_room(flow, i + 1);
+        ring->write(&message);
+      }
+    });
+  }
+
+  bench_pin_to_cpu(args.consumer_cpu);
+  start_line.arrive_and_wait(args.producers + 1);
+  start_ns.store(bench_now_ns(), std::memory_order_release);
+  const uint64_t record_after_ns = start_ns.load(std::memory_order_relaxed) + warmup_ns;
+  const uint64_t expected = messages_per_producer * args.producers;
+  LatencyMessage message;
+  for (uint64_t consumed = 0; consumed < expected;) {
+    if (!ring->read(&message)) { continue; }
+    const uint64_t now = bench_now_ns();
+    flow.publish(++consumed);
+    if (message.intended_send_ns >= record_after_ns) { histogram->record(now - message.intended_send_ns); }
+  }
+  for (std::thread& t : threads) { t.join(); }
+
+  std::printf("rate %.0f msg/s, %u producer(s), %" PRIu64 " recorded\n", args.rate, args.producers, histogram->count());
+  std::printf("quantile\tlatency_ns\n");
+  for (double quantile : {0.5, 0.9, 0.99, 0.999, 0.9999, 0.99999}) {
+    std::printf("%.5f\t%" PRIu64 "\n", quantile, histogram->percentile(quantile));
+  }
+  std::printf("max\t%" PRIu64 "\n", histogram->max());
+
+  if (args.slo_ns) {
+    const uint64_t measured = histogram->percentile(args.slo_quantile);
+    const bool met = measured <= args.slo_ns;
+    std::printf("SLO p%g <= %" PRIu64 " ns: %s (%" PRIu64 " ns)\n", args.slo_quantile * 100, args.slo_ns, met ? "met" : "MISSED", measured);
+    return met ? 0 : 1;
+  }
+  return 0;
+}
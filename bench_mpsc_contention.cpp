@@ -0,0 +1,223 @@
+/* MPSC contention sweep: 1 to 2x the CPU count producers against one consumer, under three
+pinning strategies, for every MPSC write variant in bench_writers (the current CAS-loop write()
+is the baseline every change is measured against).
+  g++ -std=c++17 -O2 -pthread bench_mpsc_contention.cpp -o bench_mpsc_contention
+Usage: bench_mpsc_contention [milliseconds per run] [consumer cpu]
+
+Pinning (the consumer keeps its CPU to itself whenever there are enough CPUs):
+  spread   one producer per physical core before any SMT sibling is used
+  compact  fill both SMT threads of a core before moving on, starting with the consumer's sibling
+  smt      producers only on cores with SMT siblings that the consumer does not use, a whole core
+           at a time (compact when there are none)
+Producers beyond the number of CPUs in the order wrap around (oversubscription).
+
+Per run it reports aggregate throughput, per-producer throughput, both counting only the messages
+the consumer read before the deadline (min/mean/max and Jain's
+fairness index, 1 = perfectly fair), consumer-observed latency from the producer's timestamp
+(sampled every latency_sample_every messages) and the CAS retries and region switches per message.
+*/
+#include "mpsc.cpp"
+#include "bench.hpp"
+#include <algorithm>
+#include <cinttypes>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+static constexpr unsigned bench_length = 1 << 14;
+static constexpr unsigned bench_granularity = 64;
+static constexpr uint64_t latency_sample_every = 16;
+
+struct ContentionMessage {
+  uint64_t send_ns;
+  uint64_t producer;
+  uint64_t seq;
+  uint64_t pad;
+};
+
+using ContentionRing = RingBuf<ContentionMessage, bench_length, bench_granularity, RING_BUF_COUNTERS>;
+
+struct BenchWriter {
+  const char* name;
+  void (*write)(ContentionRing* ring, ContentionMessage* message);
+};
+
+static const BenchWriter bench_writers[] = {
+  {"cas_loop", [](ContentionRing* ring, ContentionMessage* message) { ring->write(message); }},
+};
+
+struct CpuInfo {
+  int cpu;
+  int core; // lowest CPU number among its SMT siblings, so equal for exactly the siblings of a core
+  int smt_index; // position among the SMT siblings of its core
+  int smt_siblings; // number of hardware threads of its core, including itself
+};
+
+// parses a sysfs CPU list such as "0,4" or "0-1"
+static std::vector<int> parse_cpu_list(const std::string& list) {
+  std::vector<int> cpus;
+  size_t pos = 0;
+  while (pos < list.size()) {
+    const size_t comma = std::min(list.find(',', pos), list.size());
+    const std::string range = list.substr(pos, comma - pos);
+    const size_t dash = range.find('-');
+    const int first = std::atoi(range.c_str());
+    const int last = dash == std::string::npos ? first : std::atoi(range.c_str() + dash + 1);
+    for (int cpu = first; cpu <= last; ++cpu) { cpus.push_back(cpu); }
+    pos = comma + 1;
+  }
+  return cpus;
+}
+
+// SMT siblings come from thread_siblings_list; a CPU without one counts as a core of its own
+static std::vector<CpuInfo> read_cpu_topology() {
+  std::vector<CpuInfo> cpus;
+  for (unsigned cpu = 0; cpu < bench_num_cpus(); ++cpu) {
+    std::ifstream in("/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/thread_siblings_list");
+    std::string list;
+    std::vector<int> siblings = (in >> list) ? parse_cpu_list(list) : std::vector<int>();
+    if (std::find(siblings.begin(), siblings.end(), (int)cpu) == siblings.end()) { siblings = {(int)cpu}; }
+    std::sort(siblings.begin(), siblings.end());
+    const int smt_index = std::find(siblings.begin(), siblings.end(), (int)cpu) - siblings.begin();
+    cpus.push_back(CpuInfo{(int)cpu, siblings.front(), smt_index, (int)siblings.size()});
+  }
+  return cpus;
+}
+
+// the order in which producers are placed on CPUs for each pinning strategy
+static std::vector<int> producer_cpu_order(const std::vector<CpuInfo>& cpus, const char* pinning, int consumer_cpu) {
+  const CpuInfo consumer = cpus[consumer_cpu % cpus.size()];
+  std::vector<CpuInfo> candidates;
+  for (const CpuInfo& info : cpus) {
+    if (info.cpu != consumer.cpu) { candidates.push_back(info); }
+  }
+  if (candidates.empty()) { candidates.push_back(consumer); } // a single CPU: everything oversubscribes
+
+  auto order_by = [&](auto less) {
+    std::stable_sort(candidates.begin(), candidates.end(), less);
+    std::vector<int> order;
+    for (const CpuInfo& info : candidates) { order.push_back(info.cpu); }
+    return order;
+  };
+  auto by_core = [](const CpuInfo& a, const CpuInfo& b) { return a.core != b.core ? a.core < b.core : a.smt_index < b.smt_index; };
+  if (!std::strcmp(pinning, "spread")) {
+    return order_by([](const CpuInfo& a, const CpuInfo& b) { return a.smt_index != b.smt_index ? a.smt_index < b.smt_index : a.core < b.core; });
+  }
+  // smt: only cores with SMT siblings, none of them the consumer's, filled a whole core at a time
+  if (!std::strcmp(pinning, "smt")) {
+    std::vector<CpuInfo> all = candidates;
+    candidates.clear();
+    for (const CpuInfo& info : all) {
+      if (info.smt_siblings > 1 && info.core != consumer.core) { candidates.push_back(info); }
+    }
+    if (!candidates.empty()) { return order_by(by_core); }
+    candidates = all; // no SMT away from the consumer: degrade to compact
+  }
+  // compact (and smt without SMT): the consumer's siblings first, then whole cores
+  return order_by([&](const CpuInfo& a, const CpuInfo& b) {
+    if ((a.core == consumer.core) != (b.core == consumer.core)) { return a.core == consumer.core; }
+    return by_core(a, b);
+  });
+}
+
+struct alignas(ALIGN_NO_FALSE_SHARING) ProducerResult {
+  uint64_t written; // including the writes after the deadline, to check that none was lost
+};
+
+static void run(const BenchWriter& writer, const char* pinning, const std::vector<int>& cpu_order,
+  unsigned producers, unsigned milliseconds, int consumer_cpu) {
+  std::unique_ptr<ContentionRing> ring(new ContentionRing());
+  BenchFlowControl flow;
+  BenchStartLine start_line;
+  std::atomic<bool> stop{false};
+  std::vector<ProducerResult> results(producers);
+  std::vector<std::thread> threads;
+
+  for (unsigned p = 0; p < producers; ++p) {
+    threads.emplace_back([&, p] {
+      bench_pin_to_cpu(cpu_order[p % cpu_order.size()]);
+      ContentionMessage message{0, p, 0, 0};
+      start_line.arrive_and_wait(producers + 1);
+      while (!stop.load(std::memory_order_relaxed)) {
+        flow.take_credit(bench_length / 2);
+        message.send_ns = bench_now_ns();
+        ++message.seq;
+        writer.write(ring.get(), &message);
+      }
+      results[p].written = message.seq;
+    });
+  }
+
+  bench_pin_to_cpu(consumer_cpu);
+  std::vector<uint64_t> latencies;
+  latencies.reserve(1 << 20);
+  ContentionMessage message;
+  uint64_t consumed = 0;
+  std::vector<uint64_t> consumed_by_deadline(producers); // per producer; throughput only counts these
+  start_line.arrive_and_wait(producers + 1);
+  const uint64_t start_ns = bench_now_ns(), deadline_ns = start_ns + milliseconds * 1'000'000ull;
+  while (bench_now_ns() < deadline_ns) {
+    if (!ring->read(&message)) { continue; }
+    flow.publish(++consumed);
+    ++consumed_by_deadline[message.producer];
+    if (!(consumed & (latency_sample_every - 1))) { latencies.push_back(bench_now_ns() - message.send_ns); }
+  }
+  stop.store(true, std::memory_order_relaxed);
+  const uint64_t elapsed_ns = bench_now_ns() - start_ns;
+  // producers may be waiting for room, so keep consuming until they are all done
+  std::atomic<bool> joined{false};
+  std::thread joiner([&] { for (std::thread& t : threads) { t.join(); } joined.store(true, std::memory_order_release); });
+  while (!joined.load(std::memory_order_acquire)) {
+    if (ring->read(&message)) { flow.publish(++consumed); }
+  }
+  joiner.join();
+  while (ring->read(&message)) { ++consumed; }
+
+  uint64_t written = 0;
+  for (const ProducerResult& result : results) { written += result.written; }
+  uint64_t total = 0, min_written = UINT64_MAX, max_written = 0;
+  double sum_squares = 0;
+  for (uint64_t producer_total : consumed_by_deadline) {
+    total += producer_total;
+    min_written = std::min(min_written, producer_total);
+    max_written = std::max(max_written, producer_total);
+    sum_squares += (double)producer_total * producer_total;
+  }
+  const double jain = sum_squares ? (double)total * total / (producers * sum_squares) : 0;
+  const double to_mmsg_per_s = 1e3 / elapsed_ns;
+
+  std::sort(latencies.begin(), latencies.end());
+  auto percentile = [&](double q) { return latencies.empty() ? 0 : latencies[(size_t)(q * (latencies.size() - 1))]; };
+  const RingBufCounters counters = ring->counters_snapshot();
+
+  std::printf("%s\t%s\t%u\t%.3f\t%.3f\t%.3f\t%.3f\t%.3f\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%.3f\t%.3f%s\n",
+    writer.name, pinning, producers, total * to_mmsg_per_s,
+    min_written * to_mmsg_per_s, (double)total / producers * to_mmsg_per_s, max_written * to_mmsg_per_s, jain,
+    percentile(0.5), percentile(0.99), percentile(0.999), latencies.empty() ? 0 : latencies.back(),
+    written ? (double)counters.cas_retries / written : 0, written ? (double)counters.region_switches / written : 0,
+    consumed == written ? "" : "\tLOST MESSAGES");
+}
+
+int main(int argc, char** argv) {
+  unsigned milliseconds = argc > 1 ? (unsigned)std::atoi(argv[1]) : 200;
+  int consumer_cpu = argc > 2 ? std::atoi(argv[2]) : 0;
+  const std::vector<CpuInfo> cpus = read_cpu_topology();
+
+  std::printf("writer\tpinning\tproducers\tMmsg/s\tmin/prod\tmean/prod\tmax/prod\tjain\tp50_ns\tp99_ns\tp999_ns\tmax_ns\tcas_retries/msg\tregion_switches/msg\n");
+  for (const BenchWriter& writer : bench_writers) {
+    for (const char* pinning : {"spread", "compact", "smt"}) {
+      const std::vector<int> cpu_order = producer_cpu_order(cpus, pinning, consumer_cpu);
+      for (unsigned producers = 1; producers <= 2 * cpus.size(); producers = producers < 4 ? producers + 1 : producers * 2) {
+        run(writer, pinning, cpu_order, producers, milliseconds, consumer_cpu);
+      }
+      if (2 * cpus.size() > 4 && (2 * cpus.size() & (2 * cpus.size() - 1))) {
+        run(writer, pinning, cpu_order, 2 * cpus.size(), milliseconds, consumer_cpu); // always end at exactly 2x
+      }
+    }
+  }
+  return 0;
+}
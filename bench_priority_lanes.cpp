@@ -0,0 +1,113 @@
+/* Control-message latency under a flooded bulk lane, for each PriorityLanes consumer policy.
+A bulk producer keeps lane 1 as full as flow control allows while a control producer sends on
+lane 0 at a fixed rate (open loop, latency measured from the intended send time as in
+bench_latency.cpp). The consumer spends work_ns on every entry, so the bulk backlog is real.
+  g++ -std=c++17 -O2 -pthread bench_priority_lanes.cpp -o bench_priority_lanes
+Usage: bench_priority_lanes [seconds per policy] [control messages/s] [work ns] [consumer cpu]
+*/
+#include "spsc.cpp"
+#include "bench.hpp"
+#include "hdr_histogram.hpp"
+#include "priority_lanes.hpp"
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+
+static constexpr unsigned bench_length = 1 << 12;
+static constexpr unsigned control_lane = 0, bulk_lane = 1;
+static constexpr unsigned bulk_weight = 32;
+
+struct LaneMessage {
+  uint64_t intended_send_ns;
+  uint64_t seq;
+};
+
+using Lanes = PriorityLanes<LaneMessage, bench_length, 2, 64>;
+
+struct LanesArgs {
+  double seconds = 2;
+  double control_rate = 100'000;
+  uint64_t work_ns = 200;
+  int consumer_cpu = 0;
+};
+
+static void run(const char* policy, bool weighted, const LanesArgs& args) {
+  std::unique_ptr<Lanes> lanes(new Lanes());
+  lanes->weights[control_lane] = 1;
+  lanes->weights[bulk_lane] = bulk_weight;
+  std::unique_ptr<LogLinearHistogram<>> control_latency(new LogLinearHistogram<>());
+  BenchFlowControl flow[2];
+  BenchStartLine start_line;
+  std::atomic<bool> stop{false};
+  const uint64_t control_messages = (uint64_t)(args.control_rate * args.seconds);
+  uint64_t start_ns = 0;
+
+  std::thread bulk([&] {
+    bench_pin_to_cpu(args.consumer_cpu + 1);
+    LaneMessage message{0, 0};
+    start_line.arrive_and_wait(3);
+    while (!stop.load(std::memory_order_relaxed)) {
+      flow[bulk_lane].wait_for_room(message.seq + 1, bench_length / 2);
+      message.intended_send_ns = bench_now_ns();
+      ++message.seq;
+      lanes->write(bulk_lane, &message);
+    }
+  });
+  std::thread control([&] {
+    bench_pin_to_cpu(args.consumer_cpu + 2);
+    const double interval_ns = 1e9 / args.control_rate;
+    LaneMessage message{0, 0};
+    start_line.arrive_and_wait(3);
+    const uint64_t start = bench_now_ns();
+    for (uint64_t i = 0; i < control_messages; ++i) {
+      message.intended_send_ns = start + (uint64_t)(i * interval_ns);
+      while (bench_now_ns() < message.intended_send_ns) { bench_cpu_relax(); }
+      flow[control_lane].wait_for_room(i + 1, bench_length / 2);
+      ++message.seq;
+      lanes->write(control_lane, &message);
+    }
+  });
+
+  bench_pin_to_cpu(args.consumer_cpu);
+  start_line.arrive_and_wait(3);
+  start_ns = bench_now_ns();
+  uint64_t consumed[2] = {0, 0};
+  LaneMessage message;
+  unsigned lane;
+  while (consumed[control_lane] < control_messages) {
+    const bool got = weighted ? lanes->read_weighted(&message, &lane) : lanes->read_strict(&message, &lane);
+    if (!got) { continue; }
+    const uint64_t now = bench_now_ns();
+    flow[lane].publish(++consumed[lane]);
+    if (lane == control_lane) { control_latency->record(now - message.intended_send_ns); }
+    while (bench_now_ns() - now < args.work_ns) { bench_cpu_relax(); }
+  }
+  const uint64_t elapsed_ns = bench_now_ns() - start_ns;
+  stop.store(true, std::memory_order_relaxed);
+  control.join();
+  // the bulk producer may be waiting for room
+  std::atomic<bool> joined{false};
+  std::thread joiner([&] { bulk.join(); joined.store(true, std::memory_order_release); });
+  while (!joined.load(std::memory_order_acquire)) {
+    if (lanes->read_strict(&message, &lane)) { flow[lane].publish(++consumed[lane]); }
+  }
+  joiner.join();
+
+  std::printf("%s\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%.3f\n", policy, control_latency->percentile(0.5), control_latency->percentile(0.99),
+    control_latency->percentile(0.999), control_latency->max(), consumed[bulk_lane] * 1e3 / elapsed_ns);
+}
+
+int main(int argc, char** argv) {
+  LanesArgs args;
+  if (argc > 1) { args.seconds = std::atof(argv[1]); }
+  if (argc > 2) { args.control_rate = std::atof(argv[2]); }
+  if (argc > 3) { args.work_ns = std::strtoull(argv[3], nullptr, 0); }
+  if (argc > 4) { args.consumer_cpu = std::atoi(argv[4]); }
+  if (args.control_rate <= 0) { return 2; }
+
+  std::printf("policy\tcontrol_p50_ns\tcontrol_p99_ns\tcontrol_p999_ns\tcontrol_max_ns\tbulk_Mmsg/s\n");
+  run("strict", false, args);
+  run("weighted", true, args);
+  return 0;
+}
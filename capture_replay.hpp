@@ -0,0 +1,206 @@
+#pragma once
+#include "ring_buf.hpp"
+#include "observer_cursor.hpp"
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+/* Capture a ring's stream to a file through an ObserverCursor, and play it back into another ring
+with the original timing, e.g., to reproduce a production latency incident on a bench machine.
+
+The capture never touches the ring's consumer state; it only peeks, so it sees every entry as soon
+as it is written (or misses it if the writers lap the tap, which is counted). Each record is the
+ring_buf_tsc() at which the entry was written, its sequence number and the raw entry. The write
+time is exact if the ring has RING_BUF_LATENCY (its write stamps are read under the same check as
+the entry); otherwise the record holds the time at which the tap saw the entry, which is only as
+exact as the tap's polling: run the capture thread on its own core. The file starts with a
+header that also holds the capture machine's ticks per second, so the replay converts intervals
+to its own clock. Records are fixed-size and unpadded:
+
+  CaptureFileHeader | {uint64_t tsc, uint64_t sequence_number, DataType data} ...
+*/
+static constexpr uint64_t capture_magic = 0x5041434646554252; // "RBUFFCAP"
+
+struct CaptureFileHeader {
+  uint64_t magic;
+  uint32_t data_size;
+  uint32_t reserved;
+  double ticks_per_second; // of ring_buf_tsc() on the capture machine
+  uint64_t records; // filled in by close()
+  uint64_t missed; // entries the writers overwrote before the tap saw them, filled in by close()
+};
+
+template<typename DataType>
+struct __attribute__((packed)) __capture_record {
+  uint64_t tsc;
+  uint64_t sequence_number;
+  DataType data;
+};
+
+// ring_buf_tsc() ticks per second, measured against the steady clock over calibration
+inline double ring_buf_tsc_per_second(std::chrono::milliseconds calibration = std::chrono::milliseconds(20)) {
+  const auto start = std::chrono::steady_clock::now();
+  const uint64_t start_tsc = ring_buf_tsc();
+  std::this_thread::sleep_for(calibration);
+  const uint64_t end_tsc = ring_buf_tsc();
+  const auto end = std::chrono::steady_clock::now();
+  return (end_tsc - start_tsc) / std::chrono::duration<double>(end - start).count();
+}
+
+template<typename DataType, unsigned length, unsigned version_granularity = length, unsigned flags = 0>
+struct RingCapture {
+  using Cursor = ObserverCursor<DataType, length, version_granularity, flags>;
+  static_assert(std::is_trivially_copyable_v<DataType>, "DataType must be POD (to support memcpy)");
+
+  using __record = __capture_record<DataType>;
+
+  Cursor cursor;
+  FILE* file;
+  CaptureFileHeader header;
+  std::thread capture_thread;
+  std::atomic<bool> stop_capture;
+  int write_errno; // of the first failed record write; the capture stops there
+
+  // Returns false with errno set if the file cannot be created.
+  bool open(const char* path) {
+    file = std::fopen(path, "wb");
+    if (!file) { return false; }
+    write_errno = 0;
+    std::setvbuf(file, nullptr, _IOFBF, 1 << 20);
+    header = CaptureFileHeader{capture_magic, sizeof(DataType), 0, ring_buf_tsc_per_second(), 0, 0};
+    if (std::fwrite(&header, sizeof(header), 1, file) != 1) { return fail(); }
+    cursor.skip_to_newest(); // the capture starts now
+    return true;
+  }
+
+  /* Records every entry written since the last call; returns how many. After a short write (e.g., 
+  a full disk), nothing more is recorded and close() reports the error.
+  */
+  uint64_t poll() {
+    DataType data{};
+    uint64_t sequence_number;
+    uint64_t captured = 0;
+    uint64_t write_tsc = 0; // only written with RING_BUF_LATENCY
+    while (!write_errno && cursor.next(&data, &sequence_number, &write_tsc)) {
+      const __record record{flags & RING_BUF_LATENCY ? write_tsc : ring_buf_tsc(), sequence_number, data};
+      errno = 0;
+      if (std::fwrite(&record, sizeof(record), 1, file) != 1) {
+        write_errno = errno ? errno : EIO;
+        break;
+      }
+      ++captured;
+    }
+    header.records += captured;
+    return captured;
+  }
+
+  // polls on a thread of its own until stop()
+  void start() {
+    stop();
+    stop_capture.store(false, std::memory_order_relaxed);
+    capture_thread = std::thread([this] {
+      while (!stop_capture.load(std::memory_order_relaxed)) { poll(); }
+    });
+  }
+
+  void stop() {
+    if (!capture_thread.joinable()) { return; }
+    stop_capture.store(true, std::memory_order_relaxed);
+    capture_thread.join();
+  }
+
+  /* Completes the header; returns false with errno set if the file could not be written, including 
+  a record that poll() failed to write (the header then counts the records before it).
+  */
+  bool close() {
+    stop();
+    if (!file) { return true; }
+    header.missed = cursor.missed;
+    bool ok = !std::fseek(file, 0, SEEK_SET) && std::fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = !std::fclose(file) && ok;
+    file = nullptr;
+    if (write_errno) {
+      errno = write_errno;
+      return false;
+    }
+    return ok;
+  }
+
+  RingCapture(typename Cursor::Ring* ring) : cursor(ring), file(nullptr), header{}, stop_capture(false), write_errno(0) {}
+  ~RingCapture() { close(); }
+  RingCapture(const RingCapture&) = delete;
+  RingCapture& operator=(const RingCapture&) = delete;
+
+  bool fail() {
+    const int saved_errno = errno;
+    std::fclose(file);
+    file = nullptr;
+    errno = saved_errno;
+    return false;
+  }
+};
+
+/* Writes a capture back into a ring. speed scales the recorded intervals: 1 reproduces the
+original timing, 2 plays twice as fast, and 0 writes as fast as possible. Every record is due at a
+fixed offset from the start of the replay, so a late write does not delay the ones after it;
+max_lateness_ticks (in local ring_buf_tsc() ticks) tells how far behind the schedule the replay got.
+*/
+template<typename DataType>
+struct RingReplayer {
+  using __record = __capture_record<DataType>;
+
+  FILE* file;
+  CaptureFileHeader header;
+  uint64_t max_lateness_ticks;
+
+  // Returns false with errno set if the file cannot be read or holds another DataType.
+  bool open(const char* path) {
+    file = std::fopen(path, "rb");
+    if (!file) { return false; }
+    std::setvbuf(file, nullptr, _IOFBF, 1 << 20);
+    if (std::fread(&header, sizeof(header), 1, file) != 1 || header.magic != capture_magic || header.data_size != sizeof(DataType)) {
+      std::fclose(file);
+      file = nullptr;
+      errno = EINVAL;
+      return false;
+    }
+    return true;
+  }
+
+  // Returns the number of entries written to ring (anything with a write(DataType*)).
+  template<typename Ring>
+  uint64_t replay(Ring& ring, double speed = 1) {
+    const double local_ticks_per_capture_tick = speed > 0 ? ring_buf_tsc_per_second() / header.ticks_per_second / speed : 0;
+    __record record;
+    uint64_t replayed = 0;
+    uint64_t first_capture_tsc = 0, start_tsc = 0;
+    max_lateness_ticks = 0;
+    while (std::fread(&record, sizeof(record), 1, file) == 1) {
+      if (!replayed) {
+        first_capture_tsc = record.tsc;
+        start_tsc = ring_buf_tsc();
+      }
+      if (local_ticks_per_capture_tick > 0) {
+        const uint64_t due_tsc = start_tsc + (uint64_t)((record.tsc - first_capture_tsc) * local_ticks_per_capture_tick);
+        uint64_t now;
+        while ((now = ring_buf_tsc()) < due_tsc) {}
+        max_lateness_ticks = std::max(max_lateness_ticks, now - due_tsc);
+      }
+      DataType data = record.data; // the record is packed, data may be misaligned
+      ring.write(&data);
+      ++replayed;
+    }
+    return replayed;
+  }
+
+  void close() {
+    if (file) { std::fclose(file); }
+    file = nullptr;
+  }
+
+  RingReplayer() : file(nullptr), header{}, max_lateness_ticks(0) {}
+  ~RingReplayer() { close(); }
+  RingReplayer(const RingReplayer&) = delete;
+  RingReplayer& operator=(const RingReplayer&) = delete;
+};
@@ -0,0 +1,125 @@
+#pragma once
+#include <tuple>
+#include "ring_buf.hpp"
+
+/* Structure-of-arrays ring: each described field of Record lives in its own array indexed by
+sequence number, so a consumer that only aggregates a few fields streams through just those
+columns, and a batch read hands out contiguous column spans that the compiler can vectorize.
+Fields are described by member pointers, e.g.
+  ColumnarRing<Quote, 4096, &Quote::price, &Quote::quantity, &Quote::instrument_id>
+and fields that are not listed are not stored.
+
+Single producer, single consumer. The producer scatters a record into the columns and then
+publishes it by advancing write_sequence_number (release), so every entry below it is complete
+in every column and a batch needs no per-entry check. As with RingBuf, the producer is not held
+back by the consumer, so it can lap it and overwrite entries that were not read yet. The consumer
+re-checks write_sequence_number after it copied an entry or used a batch: read() and read_batch()
+skip entries that were overwritten, and consume() reports those overwritten while the batch was in
+use, so that the caller can drop what it computed from them. All of them count in lost_entries.
+*/
+template<typename T>
+struct __member_pointer_traits;
+template<typename Record, typename Member>
+struct __member_pointer_traits<Member Record::*> {
+  using record_type = Record;
+  using member_type = Member;
+};
+
+template<typename Record, unsigned length, auto... fields>
+struct ColumnarRing {
+  static_assert(length && !(length & (length - 1)), "length must be a power of 2");
+  static_assert(sizeof...(fields), "describe at least one field");
+  static_assert((std::is_same_v<typename __member_pointer_traits<decltype(fields)>::record_type, Record> && ...),
+    "every field must be a data member pointer of Record");
+  static_assert((std::is_trivially_copyable_v<typename __member_pointer_traits<decltype(fields)>::member_type> && ...),
+    "field types must be POD");
+
+  template<auto field>
+  using field_type = typename __member_pointer_traits<decltype(field)>::member_type;
+
+  template<auto field>
+  struct alignas(ALIGN_NO_FALSE_SHARING) __column {
+    field_type<field> values[length];
+  };
+  std::tuple<__column<fields>...> columns;
+
+  alignas(ALIGN_NO_FALSE_SHARING) std::atomic<uint64_t> write_sequence_number; // entries published so far
+  alignas(ALIGN_NO_FALSE_SHARING) uint64_t read_sequence_number; // consumer only
+  uint64_t lost_entries; // consumer only: overwritten by the producer before they were read
+
+  template<auto field>
+  field_type<field>* column() { return std::get<__column<field>>(columns).values; }
+
+  void write(const Record* record) {
+    const uint64_t seq = write_sequence_number.load(std::memory_order_relaxed);
+    const unsigned idx = seq & (length - 1);
+    ((column<fields>()[idx] = record->*fields), ...);
+    write_sequence_number.store(seq + 1, std::memory_order_release);
+  }
+
+  /* The oldest entry that is still intact once written entries are published: the producer may
+  already be writing entry written, over entry written - length.
+  */
+  static uint64_t oldest_intact(uint64_t written) { return written >= length ? written - length + 1 : 0; }
+
+  void skip_to(uint64_t seq) {
+    lost_entries += seq - read_sequence_number;
+    read_sequence_number = seq;
+  }
+
+  // Gathers the described fields of the next entry into ret_data; other fields are left alone.
+  bool read(Record* ret_data) {
+    for (;;) {
+      if (read_sequence_number == write_sequence_number.load(std::memory_order_acquire)) { return false; }
+      const unsigned idx = read_sequence_number & (length - 1);
+      ((ret_data->*fields = column<fields>()[idx]), ...);
+      std::atomic_thread_fence(std::memory_order_acquire); // the copy happens before the re-check
+      const uint64_t oldest = oldest_intact(write_sequence_number.load(std::memory_order_relaxed));
+      if (read_sequence_number >= oldest) {
+        ++read_sequence_number;
+        return true;
+      }
+      skip_to(oldest); // the copy may be torn
+    }
+  }
+
+  /* Contiguous run of published entries starting at the consumer's position. It stops at the end
+  of the arrays, so a run that wraps takes two batches. The spans stay valid until consume().
+  */
+  struct Batch {
+    ColumnarRing* ring;
+    unsigned first_index;
+    unsigned count;
+
+    template<auto field>
+    const field_type<field>* column() const { return ring->template column<field>() + first_index; }
+  };
+
+  Batch read_batch(unsigned max_count) {
+    const uint64_t written = write_sequence_number.load(std::memory_order_acquire);
+    if (read_sequence_number < oldest_intact(written)) { skip_to(oldest_intact(written)); }
+    const uint64_t available = written - read_sequence_number;
+    const unsigned first_index = read_sequence_number & (length - 1);
+    const unsigned until_wrap = length - first_index;
+    uint64_t count = std::min<uint64_t>(available, max_count);
+    count = std::min<uint64_t>(count, until_wrap);
+    return Batch{this, first_index, (unsigned)count};
+  }
+
+  /* Releases the first count entries of the last batch and returns how many of them, from the
+  first one on, the producer may have overwritten while the batch was in use (0 unless it lapped
+  the consumer); whatever was computed from those must be dropped.
+  */
+  unsigned consume(unsigned count) {
+    std::atomic_thread_fence(std::memory_order_acquire); // the caller's reads of the batch happen before the re-check
+    const uint64_t oldest = oldest_intact(write_sequence_number.load(std::memory_order_relaxed));
+    const unsigned overwritten = (unsigned)std::min<uint64_t>(oldest > read_sequence_number ? oldest - read_sequence_number : 0, count);
+    lost_entries += overwritten;
+    read_sequence_number += count;
+    return overwritten;
+  }
+
+  ColumnarRing() : read_sequence_number(0), lost_entries(0) {
+    write_sequence_number.store(0, std::memory_order_relaxed);
+  }
+};
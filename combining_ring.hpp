@@ -0,0 +1,103 @@
+#pragma once
+#include "ring_buf.hpp"
+
+/* Write-combining channel for tiny messages (8-16 bytes). Instead of one slot per message, each
+producer gathers messages in a private line and publishes the whole line as one RingBuf entry, so
+the consumer pulls several messages per cache-line transfer and the producer pays one version
+number release per line. The line size is chosen so that a slot, stamp included, fits line_size
+bytes; a line holds `capacity` messages.
+
+A Producer handle belongs to one thread. It publishes its line when the line is full, or, if
+max_delay_ticks (in ring_buf_tsc() ticks) is set, on the first write() that finds the oldest
+pending message older than that. A producer that goes idle has to call poll() or flush() itself,
+since nothing else can see its line. Include spsc.cpp for a single producer or mpsc.cpp for
+several; messages of one producer stay in order, those of different producers interleave by line.
+*/
+template<typename Message, unsigned length, unsigned version_granularity = length, unsigned flags = 0, unsigned line_size = 64>
+struct CombiningRing {
+  static_assert(std::is_trivially_copyable_v<Message>, "Message must be POD (to support memcpy)");
+  static_assert(!(flags & RING_BUF_LATENCY), "RING_BUF_LATENCY would time lines, not messages");
+
+  template<unsigned line_capacity>
+  struct __line {
+    Message messages[line_capacity];
+    uint32_t count;
+  };
+  template<unsigned line_capacity>
+  static constexpr size_t slot_size() { return sizeof(typename RingBuf<__line<line_capacity>, length, version_granularity, flags>::versioned_DataType); }
+  // the most messages whose slot still fits line_size, at least 1
+  template<unsigned line_capacity>
+  static constexpr unsigned fit() {
+    if constexpr (line_capacity <= 1) { return 1; }
+    else if constexpr (slot_size<line_capacity>() <= line_size) { return line_capacity; }
+    else { return fit<line_capacity - 1>(); }
+  }
+  static constexpr unsigned capacity = fit<line_size / sizeof(Message) ? line_size / sizeof(Message) : 1>();
+
+  using Line = __line<capacity>;
+  using Ring = RingBuf<Line, length, version_granularity, flags>;
+
+  Ring ring;
+
+  // consumer only: the line being unpacked
+  Line current;
+  unsigned next_index;
+
+  struct Producer {
+    CombiningRing* channel;
+    uint64_t max_delay_ticks; // 0: size-based flushing only
+    uint64_t first_pending_tsc;
+    Line pending;
+
+    void write(const Message& message) {
+      if (!pending.count && max_delay_ticks) { first_pending_tsc = ring_buf_tsc(); }
+      pending.messages[pending.count++] = message;
+      if (pending.count == capacity || (max_delay_ticks && ring_buf_tsc() - first_pending_tsc >= max_delay_ticks)) { flush(); }
+    }
+
+    // publishes the pending messages, if any
+    void flush() {
+      if (!pending.count) { return; }
+      channel->ring.write(&pending);
+      pending.count = 0;
+    }
+
+    // flushes if the oldest pending message is due (never without max_delay_ticks); returns whether a line was published
+    bool poll() {
+      if (!max_delay_ticks || !pending.count || ring_buf_tsc() - first_pending_tsc < max_delay_ticks) { return false; }
+      flush();
+      return true;
+    }
+
+    Producer(CombiningRing* channel, uint64_t max_delay_ticks = 0)
+      : channel(channel), max_delay_ticks(max_delay_ticks), first_pending_tsc(0) { pending.count = 0; }
+    ~Producer() { flush(); }
+    Producer(const Producer&) = delete;
+    Producer& operator=(const Producer&) = delete;
+  };
+
+  bool read(Message* ret_data) {
+    if (next_index == current.count) {
+      if (!ring.read(&current)) { return false; }
+      next_index = 0;
+    }
+    *ret_data = current.messages[next_index++];
+    return true;
+  }
+
+  /* Hands out the rest of the current line, or the next line, in place: *ret_messages points to
+  the returned number of messages, valid until the next read() or read_line().
+  */
+  unsigned read_line(const Message** ret_messages) {
+    if (next_index == current.count) {
+      if (!ring.read(&current)) { return 0; }
+      next_index = 0;
+    }
+    *ret_messages = current.messages + next_index;
+    const unsigned count = current.count - next_index;
+    next_index = current.count;
+    return count;
+  }
+
+  CombiningRing() : next_index(0) { current.count = 0; }
+};
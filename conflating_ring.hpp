@@ -0,0 +1,83 @@
+#pragma once
+#include "ring_buf.hpp"
+
+/* Latest-value (conflating) channel keyed by a dense id in [0, num_keys), e.g., an instrument id.
+write() overwrites the key's pending value; read() returns every key that was written since it was
+last read, once, with its newest value. A consumer that falls behind therefore does work in the
+number of distinct keys updated, not in the number of messages.
+
+It is a slot table with one seqlock-protected value per key plus a RingBuf of dirty-key
+notifications. A key is pushed onto the notification ring only when its dirty flag goes from 0 to
+1, so at most num_keys notifications are ever pending and the ring (length >= num_keys) cannot
+overflow. A write that lands between the consumer clearing the flag and copying the value notifies
+again although the consumer already copied the new value; the consumer remembers the version it
+delivered per key and drops such a notification, so every value is delivered at most once.
+Include spsc.cpp for a single producer or mpsc.cpp for several; different producers may share the
+channel as long as no two of them write the same key at the same time.
+*/
+template<typename DataType, unsigned num_keys>
+struct ConflatingRing {
+  static_assert(num_keys, "num_keys must be positive");
+  static_assert(std::is_trivially_copyable_v<DataType>, "DataType must be POD (to support memcpy)");
+
+  static constexpr unsigned notification_length() {
+    unsigned notification_length = 1;
+    while (notification_length < num_keys) { notification_length <<= 1; }
+    return notification_length;
+  }
+
+  struct alignas(ALIGN_NO_FALSE_SHARING) __keyed_slot {
+    std::atomic<uint64_t> version; // odd while the key's writer is copying value in
+    std::atomic<uint32_t> dirty; // 1 while a notification for the key is pending
+    DataType value;
+  };
+  __keyed_slot slots[num_keys];
+
+  RingBuf<uint32_t, notification_length()> dirty_keys;
+  uint64_t delivered_versions[num_keys]; // consumer only: the version read() last returned per key
+
+  void write(uint32_t key, DataType* data) {
+    __keyed_slot& slot = slots[key];
+    slot.version.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release); // odd version is visible before any of the new value
+    std::memcpy(&slot.value, data, sizeof(DataType));
+    slot.version.fetch_add(1, std::memory_order_release);
+
+    /* acq_rel pairs with the consumer's exchange: either the consumer clears the flag after this
+    exchange and then reads the value written above, or this exchange sees the cleared flag and
+    notifies again
+    */
+    if (!slot.dirty.exchange(1, std::memory_order_acq_rel)) { dirty_keys.write(&key); }
+  }
+
+  /* Returns whether a dirty key was found; if so, stores it in ret_key and its latest value in
+  ret_data. Single consumer only, like RingBuf::read().
+  */
+  bool read(uint32_t* ret_key, DataType* ret_data) {
+    uint32_t key;
+    uint64_t version_before;
+    do {
+      if (!dirty_keys.read(&key)) { return false; }
+      __keyed_slot& slot = slots[key];
+      slot.dirty.exchange(0, std::memory_order_acq_rel); // clear first so that later writes notify again
+
+      do {
+        version_before = slot.version.load(std::memory_order_acquire);
+        std::memcpy(ret_data, &slot.value, sizeof(DataType));
+        std::atomic_thread_fence(std::memory_order_acquire);
+      } while ((version_before & 1) || slot.version.load(std::memory_order_relaxed) != version_before);
+    } while (version_before == delivered_versions[key]); // already delivered by the previous read of key
+    delivered_versions[key] = version_before;
+    *ret_key = key;
+    return true;
+  }
+
+  ConflatingRing() {
+    for (__keyed_slot& slot : slots) {
+      slot.version.store(0, std::memory_order_relaxed);
+      slot.dirty.store(0, std::memory_order_relaxed);
+      std::memset(&slot.value, 0, sizeof(DataType));
+    }
+    for (uint64_t& version : delivered_versions) { version = 0; }
+  }
+};
@@ -0,0 +1,153 @@
+#pragma once
+#include "ring_buf.hpp"
+#include <cassert>
+#include <climits>
+#include <ctime>
+#include <linux/futex.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+
+/* Shared-nothing messaging for a thread-per-core design: a full mesh of num_cores * (num_cores - 1)
+RingBufs, one lane per ordered pair of cores, each with exactly one producer and one consumer, so
+include spsc.cpp. No two senders ever write the same sequence number or version number.
+
+Each core has a doorbell, a bitmask of the lanes into it that may hold messages. A sender sets its
+bit only if it is clear, so while the receiver is busy a stream of sends reads the doorbell line
+without writing it. drain() takes the whole mask at once and reads up to drain_batch messages from
+each flagged lane in turn; a lane that filled its batch is looked at again by the next drain()
+without waiting for another ring, so a chatty core cannot starve the others.
+
+A core with nothing to do may wait() on its doorbell (a futex), and senders wake it up; a runtime
+that busy-polls never calls wait() and senders then never enter the kernel. Lanes overwrite when
+full like any RingBuf, so size them for the largest burst a core can send another before it drains.
+*/
+template<typename DataType, unsigned num_cores, unsigned length, unsigned version_granularity = length, unsigned flags = 0, unsigned drain_batch = 16>
+struct CoreMesh {
+  using Lane = RingBuf<DataType, length, version_granularity, flags>;
+  static_assert(num_cores >= 2 && num_cores <= 64, "one doorbell bit per sending core");
+  static_assert(drain_batch, "drain() must make progress");
+  static_assert(std::is_trivially_copyable_v<DataType>, "DataType must be POD (to support memcpy)");
+
+  static constexpr unsigned num_lanes = num_cores * (num_cores - 1);
+
+  struct alignas(ALIGN_NO_FALSE_SHARING) __doorbell {
+    std::atomic<uint64_t> pending_lanes; // bit per sending core
+    std::atomic<uint32_t> parked; // futex word, 1 while the receiver is in wait()
+  };
+  struct alignas(ALIGN_NO_FALSE_SHARING) __receiver {
+    uint64_t unfinished_lanes; // lanes that filled a batch in the last drain(), receiver only
+  };
+
+  Lane lanes[num_lanes]; // grouped by receiver, so a core drains neighbouring rings
+  __doorbell doorbells[num_cores];
+  __receiver receivers[num_cores];
+  std::thread threads[num_cores];
+
+  // there is no lane from a core to itself: it would alias the lane from core - 1, a second producer on an SPSC ring
+  Lane& lane(unsigned from, unsigned to) {
+    assert(from != to && from < num_cores && to < num_cores);
+    return lanes[to * (num_cores - 1) + (from < to ? from : from - 1)];
+  }
+
+  // from != to: a core that wants to queue work for itself has to do so outside the mesh
+  void send(unsigned from, unsigned to, DataType* data) {
+    lane(from, to).write(data);
+    __doorbell& doorbell = doorbells[to];
+    const uint64_t bit = 1ull << from;
+    /* Orders the write before the doorbell check; paired with the seq_cst exchange in drain(), a
+    bit found set is taken by a drain() that then sees this write.
+    */
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (doorbell.pending_lanes.load(std::memory_order_relaxed) & bit) { return; }
+    if (doorbell.pending_lanes.fetch_or(bit, std::memory_order_seq_cst)) { return; } // a sender that found it empty does the wakeup
+    if (doorbell.parked.exchange(0, std::memory_order_seq_cst)) { // a wait() that has not slept yet then does not sleep at all
+      syscall(SYS_futex, &doorbell.parked, FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+    }
+  }
+
+  /* Calls on_message(unsigned from, DataType&) for the messages waiting for core, at most
+  drain_batch per lane; returns how many. Only core's own thread may drain it.
+  */
+  template<typename F>
+  unsigned drain(unsigned core, F&& on_message) {
+    __doorbell& doorbell = doorbells[core];
+    uint64_t pending = receivers[core].unfinished_lanes;
+    if (doorbell.pending_lanes.load(std::memory_order_relaxed)) { // only write the shared line if someone rang
+      pending |= doorbell.pending_lanes.exchange(0, std::memory_order_seq_cst);
+    }
+    uint64_t unfinished = 0;
+    unsigned drained = 0;
+    DataType batch[drain_batch];
+    while (pending) {
+      const unsigned from = __builtin_ctzll(pending);
+      pending &= pending - 1;
+      const unsigned count = lane(from, core).read_batch(batch, drain_batch);
+      for (unsigned i = 0; i < count; ++i) { on_message(from, batch[i]); }
+      if (count == drain_batch) { unfinished |= 1ull << from; }
+      drained += count;
+    }
+    receivers[core].unfinished_lanes = unfinished;
+    return drained;
+  }
+
+  // Sleeps until a sender rings core's doorbell, or for at most timeout_ns if it is nonzero.
+  void wait(unsigned core, uint64_t timeout_ns = 0) {
+    __doorbell& doorbell = doorbells[core];
+    doorbell.parked.store(1, std::memory_order_seq_cst);
+    if (!doorbell.pending_lanes.load(std::memory_order_seq_cst) && !receivers[core].unfinished_lanes) {
+      const timespec timeout{(time_t)(timeout_ns / 1000000000), (long)(timeout_ns % 1000000000)};
+      syscall(SYS_futex, &doorbell.parked, FUTEX_WAIT_PRIVATE, 1, timeout_ns ? &timeout : nullptr, nullptr, 0);
+    }
+    doorbell.parked.store(0, std::memory_order_relaxed);
+  }
+
+  /* The runtime: runs body(unsigned core) on one thread per core, pinned to CPU first_cpu + core
+  (modulo the CPUs there are; a negative first_cpu leaves the threads unpinned), until join().
+  */
+  template<typename F>
+  void start(F body, int first_cpu = 0) {
+    for (unsigned core = 0; core < num_cores; ++core) {
+      threads[core] = std::thread([body, core, first_cpu] {
+        if (first_cpu >= 0) {
+          cpu_set_t set;
+          CPU_ZERO(&set);
+          CPU_SET((first_cpu + core) % std::max(1u, std::thread::hardware_concurrency()), &set);
+          pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        }
+        body(core);
+      });
+    }
+  }
+
+  void join() {
+    for (unsigned core = 0; core < num_cores; ++core) {
+      if (threads[core].joinable()) { threads[core].join(); }
+    }
+  }
+
+  // A core's own view of the mesh, so its code does not pass its index around.
+  struct Core {
+    CoreMesh* mesh;
+    unsigned self;
+
+    void send(unsigned to, DataType* data) { mesh->send(self, to, data); }
+    template<typename F>
+    unsigned drain(F&& on_message) { return mesh->drain(self, std::forward<F>(on_message)); }
+    void wait(uint64_t timeout_ns = 0) { mesh->wait(self, timeout_ns); }
+  };
+  Core core(unsigned self) { return Core{this, self}; }
+
+  CoreMesh() {
+    for (unsigned core = 0; core < num_cores; ++core) {
+      doorbells[core].pending_lanes.store(0, std::memory_order_relaxed);
+      doorbells[core].parked.store(0, std::memory_order_relaxed);
+      receivers[core].unfinished_lanes = 0;
+    }
+  }
+  ~CoreMesh() { join(); }
+  CoreMesh(const CoreMesh&) = delete;
+  CoreMesh& operator=(const CoreMesh&) = delete;
+};
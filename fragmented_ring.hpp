@@ -0,0 +1,139 @@
+#pragma once
+#include "ring_buf.hpp"
+
+/* Variable-size messages over fixed, small slots: a message larger than one slot's payload is
+split across consecutive slots, each a Fragment that carries the message size and continuation
+flags, and is put back together on the consumer side. Slots can thus be sized for the common
+message while the occasional jumbo one still goes through the same ring, in order.
+
+The producer copies payload bytes straight into the slots (reserve()/commit()), and the consumer
+either copies a message out with read() or looks at it in place with consume(): the fragments
+stay in their slots and are handed out as a list of spans, so nothing is copied. Since every slot
+ends in its stamp, the fragments of one message are never adjacent in memory; only a message that
+fits one fragment comes as a single contiguous span (FragmentedMessage::contiguous()).
+
+Fragments of a message must take consecutive sequence numbers, so there is a single producer
+(include spsc.cpp). A message may span at most half the ring.
+*/
+enum FragmentFlags : uint32_t {
+  FRAGMENT_FIRST = 1u << 0,
+  FRAGMENT_LAST = 1u << 1, // a fragment with neither flag continues a message
+};
+
+template<unsigned fragment_size>
+struct Fragment {
+  uint32_t message_size; // of the whole message, in every fragment
+  uint32_t fragment_flags;
+  unsigned char bytes[fragment_size];
+};
+
+template<unsigned fragment_size, unsigned length, unsigned version_granularity = length, unsigned flags = 0>
+struct FragmentedRing {
+  using Ring = RingBuf<Fragment<fragment_size>, length, version_granularity, flags>;
+  static_assert(fragment_size, "fragments must carry payload");
+
+  static constexpr uint64_t max_message_size = (uint64_t)fragment_size * (length / 2 ? length / 2 : 1);
+  static_assert(max_message_size <= UINT32_MAX, "Fragment::message_size is 32 bits");
+
+  static constexpr unsigned fragment_count(uint64_t message_size) {
+    return message_size ? (message_size + fragment_size - 1) / fragment_size : 1;
+  }
+
+  Ring ring;
+  uint64_t dropped_fragments = 0; // skipped because they do not form a message, see ready_fragments()
+
+  // Returns false, writing nothing, if the message is larger than max_message_size.
+  bool write(const void* message, uint64_t message_size) {
+    if (message_size > max_message_size) { return false; }
+    const unsigned char* bytes = static_cast<const unsigned char*>(message);
+    const unsigned count = fragment_count(message_size);
+    for (unsigned i = 0; i < count; ++i) {
+      const typename Ring::Reservation reservation = ring.reserve();
+      Fragment<fragment_size>* fragment = reservation.data;
+      const uint64_t offset = (uint64_t)i * fragment_size;
+      fragment->message_size = (uint32_t)message_size;
+      fragment->fragment_flags = (i == 0 ? (uint32_t)FRAGMENT_FIRST : 0u) | (i + 1 == count ? (uint32_t)FRAGMENT_LAST : 0u);
+      std::memcpy(fragment->bytes, bytes + offset, std::min<uint64_t>(fragment_size, message_size - offset));
+      ring.commit(reservation);
+    }
+    return true;
+  }
+
+  // A complete message, still in its slots.
+  struct FragmentedMessage {
+    FragmentedRing* channel;
+    uint64_t size;
+    unsigned fragments;
+
+    const unsigned char* fragment(unsigned i) const { // already validated by consume()
+      return channel->ring.buf[(channel->ring.read_sequence_number + i) & (length - 1)].data.bytes;
+    }
+    uint64_t fragment_bytes(unsigned i) const {
+      return i + 1 < fragments ? fragment_size : size - (uint64_t)(fragments - 1) * fragment_size;
+    }
+    const void* contiguous() const { return fragments == 1 ? fragment(0) : nullptr; }
+
+    void copy_to(void* out) const {
+      unsigned char* to = static_cast<unsigned char*>(out);
+      for (unsigned i = 0; i < fragments; ++i) {
+        std::memcpy(to, fragment(i), fragment_bytes(i));
+        to += fragment_size;
+      }
+    }
+  };
+
+  /* Returns how many fragments the message at the reader's position has once all of them are
+  committed, or 0 if it is not complete yet. A fragment that cannot start a message (it lacks
+  FRAGMENT_FIRST, has an impossible size, or the fragment its size points to as the last one lacks
+  FRAGMENT_LAST), e.g., after a seek() into the middle of a message or a recover() that dropped a
+  fragment, is released and counted in dropped_fragments, until a well-formed message comes up.
+  */
+  unsigned ready_fragments() {
+    for (;;) {
+      const Fragment<fragment_size>* first = ring.front(0);
+      if (!first) { return 0; }
+      const unsigned fragments = first->message_size <= max_message_size ? fragment_count(first->message_size) : 0;
+      if (fragments && (first->fragment_flags & FRAGMENT_FIRST)) {
+        const Fragment<fragment_size>* last = fragments > 1 ? ring.front(fragments - 1) : first;
+        if (!last) { return 0; } // the producer is still writing it; fragments commit in order
+        if ((last->fragment_flags & FRAGMENT_LAST) && last->message_size == first->message_size) { return fragments; }
+      }
+      ring.pop();
+      ++dropped_fragments;
+    }
+  }
+
+  /* Calls on_message(const FragmentedMessage&) if a whole message is there, then releases its
+  slots; the message must not be used after on_message returns. Returns whether a message was
+  consumed.
+  */
+  template<typename F>
+  bool consume(F&& on_message) {
+    const unsigned fragments = ready_fragments();
+    if (!fragments) { return false; }
+    const FragmentedMessage message{this, ring.front(0)->message_size, fragments};
+    on_message(message);
+    ring.pop(fragments);
+    return true;
+  }
+
+  /* Copies the next message into buffer and returns true with its size, which may be 0, in
+  ret_size. Returns false with ret_size 0 if there is no message, or with the message's size if it
+  is larger than capacity; that message is left in the ring, so the caller can retry with a larger
+  buffer.
+  */
+  bool read(void* buffer, uint64_t capacity, uint64_t* ret_size) {
+    *ret_size = 0;
+    if (!ready_fragments()) { return false; }
+    const uint64_t message_size = ring.front(0)->message_size;
+    if (message_size > capacity) {
+      *ret_size = message_size;
+      return false;
+    }
+    consume([&](const FragmentedMessage& message) {
+      message.copy_to(buffer);
+      *ret_size = message.size;
+    });
+    return true;
+  }
+};
@@ -0,0 +1,79 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+/* Log-linear (HDR-style) histogram of uint64_t values such as latencies in ns or TSC ticks.
+Values below 2^sub_bucket_bits are counted exactly; above that every power of 2 is split into
+2^(sub_bucket_bits - 1) equal sub-buckets, so the relative error stays below 2^-(sub_bucket_bits - 1)
+(< 1.6% for the default 7) at any magnitude. Values of 2^max_value_bits and above land in the
+last bucket.
+
+One thread records; any thread may read at the same time. Counts are atomics updated with a
+relaxed load and store (no lock prefix), so a concurrent reader sees each bucket either before or
+after an increment, never torn, but the buckets are not a consistent cut of one another.
+*/
+template<unsigned sub_bucket_bits = 7, unsigned max_value_bits = 40>
+struct LogLinearHistogram {
+  static_assert(sub_bucket_bits >= 2 && sub_bucket_bits < max_value_bits && max_value_bits <= 64, "invalid histogram shape");
+  static constexpr unsigned half_sub_buckets = 1u << (sub_bucket_bits - 1);
+  static constexpr unsigned num_buckets = (max_value_bits - sub_bucket_bits) * half_sub_buckets + 2 * half_sub_buckets;
+
+  std::atomic<uint64_t> counts[num_buckets];
+  std::atomic<uint64_t> total;
+  std::atomic<uint64_t> max_value;
+
+  static unsigned bucket_of(uint64_t value) {
+    if (value < 2 * half_sub_buckets) { return (unsigned)value; }
+    const unsigned shift = 63 - __builtin_clzll(value) - (sub_bucket_bits - 1);
+    const unsigned bucket = shift * half_sub_buckets + (unsigned)(value >> shift);
+    return bucket < num_buckets ? bucket : num_buckets - 1;
+  }
+
+  // largest value that maps to the bucket, which is what percentiles report
+  static uint64_t highest_value_of(unsigned bucket) {
+    if (bucket < 2 * half_sub_buckets) { return bucket; }
+    const unsigned shift = bucket / half_sub_buckets - 1;
+    return ((uint64_t)(bucket - shift * half_sub_buckets + 1) << shift) - 1;
+  }
+
+  static void bump(std::atomic<uint64_t>& counter, uint64_t n) {
+    counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+  }
+
+  // single writer only
+  void record(uint64_t value) {
+    bump(counts[bucket_of(value)], 1);
+    bump(total, 1);
+    if (value > max_value.load(std::memory_order_relaxed)) { max_value.store(value, std::memory_order_relaxed); }
+  }
+
+  uint64_t count() const { return total.load(std::memory_order_relaxed); }
+  uint64_t max() const { return max_value.load(std::memory_order_relaxed); }
+
+  // smallest recorded bucket bound such that at least quantile (in [0, 1]) of the values are <= it
+  uint64_t percentile(double quantile) const {
+    uint64_t seen_total = 0;
+    for (const std::atomic<uint64_t>& bucket_count : counts) { seen_total += bucket_count.load(std::memory_order_relaxed); }
+    if (!seen_total) { return 0; }
+    uint64_t rank = (uint64_t)(quantile * seen_total + 0.5);
+    rank = rank ? rank : 1;
+    uint64_t cumulative = 0;
+    for (unsigned bucket = 0; bucket < num_buckets; ++bucket) {
+      cumulative += counts[bucket].load(std::memory_order_relaxed);
+      if (cumulative >= rank) {
+        const uint64_t highest = highest_value_of(bucket);
+        return highest < max() ? highest : max();
+      }
+    }
+    return max();
+  }
+
+  // not thread-safe with respect to a concurrent record()
+  void reset() {
+    for (std::atomic<uint64_t>& bucket_count : counts) { bucket_count.store(0, std::memory_order_relaxed); }
+    total.store(0, std::memory_order_relaxed);
+    max_value.store(0, std::memory_order_relaxed);
+  }
+
+  LogLinearHistogram() { reset(); }
+};
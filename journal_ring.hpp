@@ -0,0 +1,207 @@
+#pragma once
+#include "ring_buf.hpp"
+#include "ring_descriptor.hpp"
+#include <cerrno>
+#include <chrono>
+#include <fcntl.h>
+#include <new>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+/* RingBuf whose storage is a MAP_SHARED file mapping, so the last length entries double as a
+short-term journal. Stores to the mapping live in the page cache, so they survive a crash of
+the process without any msync; msync is only needed against an OS crash or power loss and is
+never done on the hot path: call sync() from any thread, or start_periodic_sync() for a
+background thread. header->synced_sequence_number is the newest entry known to be on disk.
+
+open() creates the file or, if it already holds a journal of the same shape (the same RingBuf
+type and implementation, see describes_ring()), reopens it and runs RingBuf::recover() so that
+writers and the reader can carry on where they stopped; any other journal fails with EINVAL.
+Entries that were claimed but never completed before the crash (possible with mpsc.cpp) leave gaps
+at or below recovered_sequence_number; read() skips them and counts them in lost_entries.
+Recovery must not run under live writers, so every process holds a shared flock on the file
+while it has the journal open, and open() only creates or recovers the journal when it gets the
+lock exclusively; otherwise it attaches to the live journal as is. The lock goes away with the
+process, so a crash never leaves the journal locked.
+replay() re-reads any retained range without consuming it. The file starts with a
+RingBufDescriptor, so ring_inspect can watch a journal while it is in use.
+*/
+template<typename DataType, unsigned length, unsigned version_granularity = length, unsigned flags = 0>
+struct JournalRing {
+  using Ring = RingBuf<DataType, length, version_granularity, flags>;
+  static_assert(alignof(Ring) <= 4096, "the ring must be placeable at a page-aligned mapping");
+
+  static constexpr uint64_t journal_magic = 0x4c4e524a46554252; // "RBUFJRNL"
+
+  struct alignas(ALIGN_NO_FALSE_SHARING) __journal_header {
+    RingBufDescriptor descriptor; // for ring_inspect
+    uint64_t magic; // written last when the journal is created
+    uint64_t ring_size; // this and the next fields must match to reopen a journal
+    uint64_t data_size;
+    uint32_t ring_length;
+    uint32_t ring_version_granularity;
+    std::atomic<uint64_t> synced_sequence_number;
+    uint64_t recovered_sequence_number; // by the last open() that recovered, for those that attach
+  };
+  static constexpr size_t ring_offset = (sizeof(__journal_header) + alignof(Ring) - 1) / alignof(Ring) * alignof(Ring);
+  static constexpr size_t mapping_size = ring_offset + sizeof(Ring);
+
+  int fd;
+  void* mapping;
+  __journal_header* header;
+  Ring* ring;
+  uint64_t recovered_sequence_number; // 0 for a new journal
+  uint64_t lost_entries; // gaps skipped by read()
+  std::thread sync_thread;
+  std::atomic<bool> stop_sync;
+
+  // The newest claimed sequence number; the SPSC and MPSC write sequence numbers share storage.
+  uint64_t written_sequence_number() const {
+    return __atomic_load_n(&ring->prod_u.write_sequence_number, __ATOMIC_RELAXED);
+  }
+
+  /* The newest sequence number up to which every retained entry, from from_seq on, is committed: 
+  claimed entries that are not written yet stop the scan, gaps left by a crash do not.
+  */
+  uint64_t committed_sequence_number(uint64_t from_seq = 1) const {
+    const uint64_t newest = written_sequence_number();
+    uint64_t seq = std::max(from_seq, newest > length ? newest - length + 1 : 1);
+    for (; seq <= newest; ++seq) {
+      if (ring->peek_sequence_number(seq) < seq && seq > recovered_sequence_number) { break; }
+    }
+    return seq - 1;
+  }
+
+  // Returns false with errno set if the file cannot be created, mapped, or holds another shape.
+  bool open(const char* path) {
+    fd = ::open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) { return false; }
+    const bool alone = !flock(fd, LOCK_EX | LOCK_NB);
+    if (!alone && (errno != EWOULDBLOCK || flock(fd, LOCK_SH))) { return fail(); } // waits until the owner is done with open()
+    struct stat st;
+    if (fstat(fd, &st) || (st.st_size < (off_t)mapping_size && ftruncate(fd, mapping_size))) { return fail(); }
+    mapping = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+      mapping = nullptr;
+      return fail();
+    }
+    header = static_cast<__journal_header*>(mapping);
+
+    if (header->magic == journal_magic) {
+      ring = std::launder(reinterpret_cast<Ring*>(static_cast<char*>(mapping) + ring_offset));
+      if (header->ring_size != sizeof(Ring) || header->data_size != sizeof(DataType)
+        || header->ring_length != length || header->ring_version_granularity != version_granularity
+        || !describes_ring(&header->descriptor, ring, Ring::implementation)) {
+        errno = EINVAL;
+        return fail();
+      }
+      if (alone) { header->recovered_sequence_number = ring->recover(); }
+      recovered_sequence_number = header->recovered_sequence_number;
+      if (alone && flock(fd, LOCK_SH)) { return fail(); } // let other processes attach
+      return true;
+    }
+    if (!alone) { // its creator died before finishing it while we waited; let the next open() retry
+      errno = EAGAIN;
+      return fail();
+    }
+
+    // new (or never completely initialized) journal
+    header->ring_size = sizeof(Ring);
+    header->data_size = sizeof(DataType);
+    header->ring_length = length;
+    header->ring_version_granularity = version_granularity;
+    header->synced_sequence_number.store(0, std::memory_order_relaxed);
+    header->recovered_sequence_number = 0;
+    ring = new (static_cast<char*>(mapping) + ring_offset) Ring();
+    describe_ring(&header->descriptor, ring, mapping, Ring::implementation);
+    recovered_sequence_number = 0;
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = journal_magic;
+    if (flock(fd, LOCK_SH)) { return fail(); }
+    return true;
+  }
+
+  void close() {
+    stop_periodic_sync();
+    if (mapping) { munmap(mapping, mapping_size); }
+    if (fd >= 0) { ::close(fd); }
+    mapping = nullptr;
+    fd = -1;
+  }
+
+  void write(DataType* data) { ring->write(data); }
+
+  bool read(DataType* ret_data) {
+    while (!ring->read(ret_data)) {
+      if (ring->read_sequence_number >= recovered_sequence_number) { return false; }
+      ++ring->read_sequence_number; // claimed before the crash but never written
+      ++lost_entries;
+    }
+    return true;
+  }
+
+  /* Calls on_entry(seq, const DataType&) for every retained entry from sequence number from_seq
+  (the first written entry is 1) up to the first one that is claimed but not written yet,
+  skipping gaps left by a crash and entries that a live writer overwrites during the replay.
+  Does not consume anything, so it may run next to the reader. Returns the sequence number to
+  resume from, i.e., that of the first entry not replayed yet.
+  */
+  template<typename F>
+  uint64_t replay(uint64_t from_seq, F&& on_entry) {
+    const uint64_t newest = written_sequence_number();
+    const uint64_t oldest = newest > length ? newest - length + 1 : 1;
+    DataType data;
+    uint64_t seq = std::max(from_seq, oldest);
+    for (; seq <= newest; ++seq) {
+      const uint64_t found = ring->peek(seq, &data);
+      if (found == seq) {
+        on_entry(seq, static_cast<const DataType&>(data));
+      } else if (found < seq && seq > recovered_sequence_number) {
+        break; // not committed yet
+      }
+    }
+    return std::max(from_seq, seq);
+  }
+
+  /* Flushes the mapping to the file; MS_ASYNC only schedules the write-back. Only entries that 
+  were committed before the flush count as synced, see committed_sequence_number().
+  */
+  bool sync(bool wait = true) {
+    const uint64_t newest = committed_sequence_number(header->synced_sequence_number.load(std::memory_order_relaxed) + 1);
+    if (msync(mapping, mapping_size, wait ? MS_SYNC : MS_ASYNC)) { return false; }
+    if (wait) { header->synced_sequence_number.store(newest, std::memory_order_relaxed); }
+    return true;
+  }
+
+  void start_periodic_sync(std::chrono::milliseconds interval) {
+    stop_periodic_sync();
+    stop_sync.store(false, std::memory_order_relaxed);
+    sync_thread = std::thread([this, interval] {
+      while (!stop_sync.load(std::memory_order_relaxed)) {
+        std::this_thread::sleep_for(interval);
+        sync();
+      }
+    });
+  }
+
+  void stop_periodic_sync() {
+    if (!sync_thread.joinable()) { return; }
+    stop_sync.store(true, std::memory_order_relaxed);
+    sync_thread.join();
+  }
+
+  JournalRing() : fd(-1), mapping(nullptr), header(nullptr), ring(nullptr), recovered_sequence_number(0), lost_entries(0), stop_sync(false) {}
+  ~JournalRing() { close(); }
+  JournalRing(const JournalRing&) = delete;
+  JournalRing& operator=(const JournalRing&) = delete;
+
+  bool fail() {
+    const int saved_errno = errno;
+    close();
+    errno = saved_errno;
+    return false;
+  }
+};
@@ -0,0 +1,238 @@
+#pragma once
+#include "ring_buf.hpp"
+#include <algorithm>
+#include <sched.h>
+
+/* Spreads a stream over num_consumers consumers while every key stays in order: a key taken out
+of each entry by KeyOf (uint64_t operator()(const DataType&) const) is hashed onto one of
+num_buckets buckets, and a routing table assigns each bucket to a consumer with an MPSC RingBuf of
+its own (include mpsc.cpp). Producers and consumers take no lock; a producer's only shared write
+besides the ring is its own epoch slot.
+
+The table changes only at epoch boundaries, in rebalance(). Every entry carries the epoch its
+producer routed it in, so a consumer that was handed a bucket knows which of its entries were
+routed by the new table. It holds those back in a local FIFO (deferred) until the previous owner
+has emitted all entries of older epochs, and keeps processing its other buckets meanwhile, so
+consumers never wait on each other. An epoch is sealed once no producer can still route with the
+old table; a consumer has drained the old epoch when it read past its ring's write position at the
+seal and holds none of the old epoch's entries back. rebalance() returns false until every
+consumer has drained the previous epoch, so at most two epochs are ever in flight and three tables
+suffice.
+
+Consumers count what they emit per bucket. measure_skew() compares consumer loads since the last
+rebalance (the most loaded consumer over the mean, 1 meaning perfectly even), and plan_balanced()
+proposes a table that moves the heaviest buckets onto the least loaded consumers. One control
+thread calls rebalance(), measure_skew() and plan_balanced().
+*/
+template<typename DataType, typename KeyOf, unsigned num_consumers, unsigned length, unsigned num_buckets = 256,
+  unsigned version_granularity = length, unsigned flags = 0>
+struct KeyRouter {
+  static_assert(num_consumers && num_consumers <= UINT16_MAX, "bucket owners are 16-bit consumer indices");
+  static_assert(num_buckets && !(num_buckets & (num_buckets - 1)), "num_buckets must be a power of 2");
+  static_assert(std::is_trivially_copyable_v<DataType>, "DataType must be POD (to support memcpy)");
+
+  static constexpr unsigned max_producers = 64; // one bit each in attached_mask
+
+  struct __routed {
+    uint64_t epoch;
+    DataType data;
+  };
+  using Ring = RingBuf<__routed, length, version_granularity, flags>;
+
+  struct alignas(ALIGN_NO_FALSE_SHARING) __producer {
+    std::atomic<uint64_t> active_epoch; // epoch the producer is routing in, 0 between writes
+  };
+  struct alignas(ALIGN_NO_FALSE_SHARING) __consumer {
+    std::atomic<uint64_t> drained_epoch; // all entries of older epochs were emitted
+    std::atomic<uint64_t> seal_sequence_number; // the ring's claimed write position when the last epoch was sealed
+    // consumer only
+    __routed deferred[length];
+    uint64_t deferred_head;
+    uint64_t deferred_tail;
+    uint64_t deferred_by_epoch[2]; // by epoch parity; only the newest two epochs are in flight
+    uint32_t deferred_by_bucket[num_buckets];
+    std::atomic<uint64_t> emitted_by_bucket[num_buckets]; // written by the consumer, summed by measure_skew()
+  };
+
+  Ring rings[num_consumers];
+  __consumer consumers[num_consumers];
+  __producer producers[max_producers];
+  uint16_t owners[3][num_buckets]; // routing tables by epoch % 3
+  alignas(ALIGN_NO_FALSE_SHARING) std::atomic<uint64_t> epoch; // starts at 1
+  std::atomic<uint64_t> sealed_epoch; // no producer routes with this epoch's table, or an older one, any more
+  std::atomic<uint64_t> attached_mask; // bit p: producer index p is taken
+  uint64_t emitted_baseline[num_consumers][num_buckets]; // control thread only, counts at the last rebalance
+
+  static unsigned bucket_of(const DataType& data) {
+    return (unsigned)((KeyOf{}(data) * 0x9E3779B97F4A7C15ull) >> 32) & (num_buckets - 1); // Fibonacci hashing spreads sequential keys
+  }
+
+  // Returns the producer index to pass to write(), or -1 if max_producers are attached.
+  int attach() {
+    uint64_t mask = attached_mask.load(std::memory_order_relaxed);
+    do {
+      if (!~mask) { return -1; }
+    } while (!attached_mask.compare_exchange_weak(mask, mask | (mask + 1), std::memory_order_relaxed)); // sets the lowest clear bit
+    return __builtin_ctzll(~mask);
+  }
+
+  // Frees the producer index for a later attach(); the producer must not be in the middle of a write().
+  void detach(unsigned producer) { attached_mask.fetch_and(~(uint64_t(1) << producer), std::memory_order_release); }
+
+  void write(unsigned producer, DataType* data) {
+    std::atomic<uint64_t>& active_epoch = producers[producer].active_epoch;
+    uint64_t routing_epoch = epoch.load(std::memory_order_relaxed);
+    for (;;) { // announce the epoch, then make sure rebalance() did not move on before it could see the announcement
+      active_epoch.store(routing_epoch, std::memory_order_seq_cst);
+      const uint64_t current_epoch = epoch.load(std::memory_order_seq_cst);
+      if (current_epoch == routing_epoch) { break; }
+      routing_epoch = current_epoch;
+    }
+    __routed routed;
+    routed.epoch = routing_epoch;
+    std::memcpy(&routed.data, data, sizeof(DataType));
+    rings[owners[routing_epoch % 3][bucket_of(*data)]].write(&routed);
+    active_epoch.store(0, std::memory_order_release);
+  }
+
+  /* Returns whether an entry for consumer was available, in per-key order. Only that consumer's
+  thread may call it, and it must keep calling it for rebalance() to make progress.
+  */
+  bool read(unsigned consumer, DataType* ret_data) {
+    __consumer& state = consumers[consumer];
+    update_drained(consumer);
+    if (state.deferred_tail != state.deferred_head) {
+      const __routed& head = state.deferred[state.deferred_head & (length - 1)];
+      const unsigned bucket = bucket_of(head.data);
+      if (handed_over(consumer, head.epoch, bucket)) {
+        --state.deferred_by_epoch[head.epoch & 1];
+        --state.deferred_by_bucket[bucket];
+        ++state.deferred_head;
+        return emit(state, bucket, head.data, ret_data);
+      }
+    }
+    while (state.deferred_tail - state.deferred_head < length) { // a full FIFO leaves the rest in the ring
+      __routed& routed = state.deferred[state.deferred_tail & (length - 1)];
+      if (!rings[consumer].read(&routed)) { return false; }
+      const unsigned bucket = bucket_of(routed.data);
+      if (!state.deferred_by_bucket[bucket] && handed_over(consumer, routed.epoch, bucket)) {
+        return emit(state, bucket, routed.data, ret_data);
+      }
+      ++state.deferred_by_epoch[routed.epoch & 1];
+      ++state.deferred_by_bucket[bucket];
+      ++state.deferred_tail;
+    }
+    return false;
+  }
+
+  /* Starts a new epoch with new_owners (a consumer index per bucket) as the routing table. Returns
+  false, changing nothing, while a consumer has not drained the previous epoch yet; otherwise
+  waits for producers still routing with the old table, which only takes as long as their writes.
+  */
+  bool rebalance(const uint16_t* new_owners) {
+    const uint64_t old_epoch = epoch.load(std::memory_order_relaxed);
+    for (unsigned consumer = 0; consumer < num_consumers; ++consumer) {
+      if (consumers[consumer].drained_epoch.load(std::memory_order_acquire) < old_epoch) { return false; }
+    }
+    std::memcpy(owners[(old_epoch + 1) % 3], new_owners, sizeof(owners[0])); // the table of old_epoch - 2; its entries are all emitted
+    epoch.store(old_epoch + 1, std::memory_order_seq_cst);
+    for (unsigned producer = 0; producer < max_producers; ++producer) { // free and detached slots read 0
+      while (producers[producer].active_epoch.load(std::memory_order_seq_cst) == old_epoch) { sched_yield(); }
+    }
+    for (unsigned consumer = 0; consumer < num_consumers; ++consumer) {
+      consumers[consumer].seal_sequence_number.store(
+        rings[consumer].prod_u.atomic_global_write_sequence_number.load(std::memory_order_relaxed), std::memory_order_relaxed);
+      for (unsigned bucket = 0; bucket < num_buckets; ++bucket) {
+        emitted_baseline[consumer][bucket] = consumers[consumer].emitted_by_bucket[bucket].load(std::memory_order_relaxed);
+      }
+    }
+    sealed_epoch.store(old_epoch, std::memory_order_release);
+    return true;
+  }
+
+  // Emitted entries per bucket since the last rebalance, summed over consumers.
+  void bucket_loads(uint64_t* ret_loads) const {
+    for (unsigned bucket = 0; bucket < num_buckets; ++bucket) {
+      ret_loads[bucket] = 0;
+      for (unsigned consumer = 0; consumer < num_consumers; ++consumer) {
+        ret_loads[bucket] += consumers[consumer].emitted_by_bucket[bucket].load(std::memory_order_relaxed) - emitted_baseline[consumer][bucket];
+      }
+    }
+  }
+
+  // Most loaded consumer over the mean consumer load since the last rebalance; 1 if nothing was emitted.
+  double measure_skew() const {
+    uint64_t total = 0, most = 0;
+    for (unsigned consumer = 0; consumer < num_consumers; ++consumer) {
+      uint64_t load = 0;
+      for (unsigned bucket = 0; bucket < num_buckets; ++bucket) {
+        load += consumers[consumer].emitted_by_bucket[bucket].load(std::memory_order_relaxed) - emitted_baseline[consumer][bucket];
+      }
+      total += load;
+      most = std::max(most, load);
+    }
+    return total ? (double)most * num_consumers / total : 1;
+  }
+
+  /* Greedy table for the loads since the last rebalance: buckets from heaviest to lightest each go
+  to the least loaded consumer so far, preferring the current owner on a tie to move fewer buckets.
+  A single bucket heavier than a fair share cannot be split, so skew can stay above 1.
+  */
+  void plan_balanced(uint16_t* ret_owners) const {
+    uint64_t loads[num_buckets];
+    unsigned order[num_buckets];
+    bucket_loads(loads);
+    for (unsigned bucket = 0; bucket < num_buckets; ++bucket) { order[bucket] = bucket; }
+    std::stable_sort(order, order + num_buckets, [&](unsigned a, unsigned b) { return loads[a] > loads[b]; });
+    const uint16_t* current = owners[epoch.load(std::memory_order_relaxed) % 3];
+    uint64_t assigned[num_consumers] = {};
+    for (unsigned bucket : order) {
+      unsigned least = current[bucket];
+      for (unsigned consumer = 0; consumer < num_consumers; ++consumer) {
+        if (assigned[consumer] < assigned[least]) { least = consumer; }
+      }
+      ret_owners[bucket] = least;
+      assigned[least] += loads[bucket];
+    }
+  }
+
+  // initially, bucket b belongs to consumer b % num_consumers
+  KeyRouter() : epoch(1), sealed_epoch(0), attached_mask(0) {
+    for (unsigned bucket = 0; bucket < num_buckets; ++bucket) {
+      owners[0][bucket] = owners[1][bucket] = owners[2][bucket] = bucket % num_consumers;
+    }
+    for (__producer& producer : producers) { producer.active_epoch.store(0, std::memory_order_relaxed); }
+    for (__consumer& state : consumers) {
+      state.drained_epoch.store(1, std::memory_order_relaxed);
+      state.seal_sequence_number.store(0, std::memory_order_relaxed);
+      state.deferred_head = state.deferred_tail = 0;
+      state.deferred_by_epoch[0] = state.deferred_by_epoch[1] = 0;
+      for (unsigned bucket = 0; bucket < num_buckets; ++bucket) {
+        state.deferred_by_bucket[bucket] = 0;
+        state.emitted_by_bucket[bucket].store(0, std::memory_order_relaxed);
+      }
+    }
+    std::memset(emitted_baseline, 0, sizeof(emitted_baseline));
+  }
+
+  // whether an entry of bucket, routed to consumer in entry_epoch, may be emitted
+  bool handed_over(unsigned consumer, uint64_t entry_epoch, unsigned bucket) const {
+    const unsigned previous_owner = owners[(entry_epoch + 2) % 3][bucket]; // the table of entry_epoch - 1
+    return previous_owner == consumer || consumers[previous_owner].drained_epoch.load(std::memory_order_acquire) >= entry_epoch;
+  }
+
+  void update_drained(unsigned consumer) {
+    __consumer& state = consumers[consumer];
+    const uint64_t sealed = sealed_epoch.load(std::memory_order_acquire);
+    if (state.drained_epoch.load(std::memory_order_relaxed) > sealed) { return; }
+    if (rings[consumer].read_sequence_number < state.seal_sequence_number.load(std::memory_order_relaxed)) { return; }
+    if (state.deferred_by_epoch[sealed & 1]) { return; }
+    state.drained_epoch.store(sealed + 1, std::memory_order_release);
+  }
+
+  bool emit(__consumer& state, unsigned bucket, const DataType& data, DataType* ret_data) {
+    std::memcpy(ret_data, &data, sizeof(DataType));
+    state.emitted_by_bucket[bucket].store(state.emitted_by_bucket[bucket].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    return true;
+  }
+};
@@ -1,22 +1,25 @@
 #include "ring_buf.hpp"
 
-template<typename DataType, unsigned length, unsigned version_granularity>
-RingBuf<DataType, length, version_granularity>::RingBuf() {
+template<typename DataType, unsigned length, unsigned version_granularity, unsigned flags>
+const RingBufImplementation RingBuf<DataType, length, version_granularity, flags>::implementation = RING_BUF_MPSC;
+
+template<typename DataType, unsigned length, unsigned version_granularity, unsigned flags>
+RingBuf<DataType, length, version_granularity, flags>::RingBuf() {
   prod_u.atomic_global_write_sequence_number.store(0, std::memory_order_relaxed);
   read_sequence_number = 0;
   for (unsigned i = 0; i < version_granularity; ++i) {
     version_numbers[i].number.store(0, std::memory_order_relaxed);
   }
-  versioned_DataType start{ .sequence_number = 0 };
+  versioned_DataType start{}; // sequence number 0: unwritten
   std::fill(buf, buf + length, start);
 }
 
-template<typename DataType, unsigned length, unsigned version_granularity>
-void RingBuf<DataType, length, version_granularity>::write(DataType* data) {
+template<typename DataType, unsigned length, unsigned version_granularity, unsigned flags>
+typename RingBuf<DataType, length, version_granularity, flags>::Claim RingBuf<DataType, length, version_granularity, flags>::claim(
+  uint64_t hold, std::memory_order claim_order) {
   uint64_t local_sequence_number;
-  unsigned version_idx;
   std::atomic<uint64_t>* version_number_ptr = nullptr;
-  volatile uint64_t write_guard = 0;
+  uint64_t version_before_hold = 0;
 
   /* Description: We want to try to write to the current sequence number if there is no 
   contention with another writer, i.e., if the global write sequence number ends up being the same 
@@ -66,46 +69,232 @@ void RingBuf<DataType, length, version_granularity>::write(DataType* data) {
   (relaxed) increment, which is thread-safe as explained above.
   */
 
+  uint64_t attempts = 0; // dead unless RING_BUF_COUNTERS or the SDT probes are enabled
   do {
+    ++attempts;
     local_sequence_number = prod_u.atomic_global_write_sequence_number.load(std::memory_order_relaxed);
-    version_idx = local_sequence_number & (version_granularity - 1);
-    std::atomic<uint64_t>* next_version_number_ptr = &version_numbers[version_idx].number;
+    std::atomic<uint64_t>* next_version_number_ptr = &version_numbers[local_sequence_number & (version_granularity - 1)].number;
 
     if (next_version_number_ptr != version_number_ptr) {
-      if (version_number_ptr) { version_number_ptr->fetch_sub(1, std::memory_order_relaxed); }
-      write_guard = next_version_number_ptr->fetch_add(1, std::memory_order_relaxed);
+      if (version_number_ptr) {
+        version_number_ptr->fetch_sub(hold, std::memory_order_relaxed);
+        this->count_region_switch();
+      }
+      version_before_hold = next_version_number_ptr->fetch_add(hold, std::memory_order_relaxed);
       version_number_ptr = next_version_number_ptr;
     }
   } while (!prod_u.atomic_global_write_sequence_number.compare_exchange_weak(
     local_sequence_number, 
     local_sequence_number + 1, 
-    std::memory_order_relaxed,
+    claim_order,
     std::memory_order_relaxed
   ));
+  this->count_cas_retries(attempts - 1);
+  if (attempts > 1) { RING_BUF_PROBE3(write_retry, this, local_sequence_number + 1, attempts - 1); }
+  RING_BUF_PROBE2(write_claim, this, local_sequence_number + 1);
+  return Claim{ local_sequence_number + 1, version_number_ptr, version_before_hold };
+}
+
+template<typename DataType, unsigned length, unsigned version_granularity, unsigned flags>
+void RingBuf<DataType, length, version_granularity, flags>::write(DataType* data) {
+  static_assert(std::is_trivially_copyable_v<DataType>, "DataType must be POD (to support memcpy), otherwise use reserve()/commit() or emplace()");
+  const Claim claimed = claim(1);
+  volatile uint64_t write_guard = claimed.version_before_hold; // the copy depends on the claim, see claim()
 
-  versioned_DataType entry{*data, local_sequence_number + 1}; // first written sequence number is 1
-  if (write_guard) { std::memcpy(&buf[local_sequence_number & (length - 1)], &entry, sizeof(versioned_DataType)); }
+  /* The data goes in before the stamp, so that a slot whose writer died before releasing the region 
+  shows its new sequence number only if the entry is complete, see recover().
+  */
+  versioned_DataType& slot = buf[(claimed.sequence_number - 1) & (length - 1)];
+  this->stamp_write_time(slot, claimed.sequence_number);
+  if (write_guard != UINT64_MAX) { // always true, the branch only carries the dependency
+    std::memcpy(&slot.data, data, sizeof(DataType));
+    std::atomic_signal_fence(std::memory_order_seq_cst); // program order is all recover() needs
+    __atomic_store_n(&slot.sequence_number, (stamp_t)claimed.sequence_number, __ATOMIC_RELAXED); // first written sequence number is 1
+  }
+  this->publish_dense_stamp(claimed.sequence_number);
 
-  version_number_ptr->fetch_sub(1, std::memory_order_release);
+  claimed.version_number->fetch_add((uint64_t(1) << 32) - 1, std::memory_order_release); // drop the refcount and count the completed write
+  RING_BUF_PROBE2(write_commit, this, claimed.sequence_number);
 }
 
-template<typename DataType, unsigned length, unsigned version_granularity>
-bool RingBuf<DataType, length, version_granularity>::read(DataType* ret_data) {
+template<typename DataType, unsigned length, unsigned version_granularity, unsigned flags>
+bool RingBuf<DataType, length, version_granularity, flags>::read(DataType* ret_data) {
+  static_assert(std::is_trivially_copyable_v<DataType>, "DataType must be POD (to support memcpy), otherwise use consume() or take()");
   const unsigned version_idx = read_sequence_number & (version_granularity - 1);
   std::atomic<uint64_t>& version_number = version_numbers[version_idx].number;
 
   versioned_DataType entry;
+  uint64_t write_tsc; // dead without RING_BUF_LATENCY
   /* need full load fence to synchronize check with the memcpy (do first then check); this is not equivalent to, and hence more efficient than, 
   sequential consistency because stores that happen after the fence can still be committed out of order regardless of the fence since the version 
-  number load has relaxed semantics
+  number load has relaxed semantics. The version number is also loaded (with acquire semantics, to see the data of completed writes) before the 
+  memcpy, since a write that starts and finishes during the memcpy leaves the final check alone unchanged.
   */
+  uint64_t attempts = 0; // dead unless RING_BUF_COUNTERS or the SDT probes are enabled
+  uint64_t version_before;
   do {
+    ++attempts;
+    version_before = version_number.load(std::memory_order_acquire);
     std::memcpy(&entry, &buf[read_sequence_number & (length - 1)], sizeof(versioned_DataType));
+    write_tsc = this->write_time(entry, read_sequence_number + 1);
     std::atomic_thread_fence(std::memory_order_acquire);
-  } while (version_number.load(std::memory_order_relaxed));
+  } while ((uint32_t)version_before || version_number.load(std::memory_order_relaxed) != version_before);
+  this->count_torn_read_retries(attempts - 1);
+  if (attempts > 1) { RING_BUF_PROBE3(read_retry, this, read_sequence_number + 1, attempts - 1); }
 
-  unsigned char success = (uint64_t)(read_sequence_number - entry.sequence_number) >> 63; // success iff sequence number > read sequence number
-  if (success) { std::memcpy(ret_data, &entry.data, sizeof(DataType)); } // conditional since DataType may be large, e.g., a whole network packet
+  unsigned char success = stamp_after(entry.sequence_number, read_sequence_number); // success iff sequence number > read sequence number
+  if (success) {
+    std::memcpy(ret_data, &entry.data, sizeof(DataType)); // conditional since DataType may be large, e.g., a whole network packet
+    this->record_latency(write_tsc);
+    RING_BUF_PROBE2(read_success, this, read_sequence_number + 1);
+  } else {
+    this->count_failed_read();
+    RING_BUF_PROBE2(read_empty, this, read_sequence_number + 1);
+  }
   read_sequence_number += success;
   return success;
-}
\ No newline at end of file
+}
+
+template<typename DataType, unsigned length, unsigned version_granularity, unsigned flags>
+uint64_t RingBuf<DataType, length, version_granularity, flags>::peek(uint64_t seq, DataType* ret_data, uint64_t* ret_write_tsc) {
+  static_assert(std::is_trivially_copyable_v<DataType>, "DataType must be POD (to support memcpy), otherwise use consume() or take()");
+  const unsigned version_idx = (seq - 1) & (version_granularity - 1);
+  std::atomic<uint64_t>& version_number = version_numbers[version_idx].number;
+
+  versioned_DataType entry;
+  uint64_t write_tsc; // 0 without RING_BUF_LATENCY
+  uint64_t version_before; // see read()
+  do {
+    version_before = version_number.load(std::memory_order_acquire);
+    std::memcpy(&entry, &buf[(seq - 1) & (length - 1)], sizeof(versioned_DataType));
+    write_tsc = this->write_time(entry, seq);
+    std::atomic_thread_fence(std::memory_order_acquire);
+  } while ((uint32_t)version_before || version_number.load(std::memory_order_relaxed) != version_before);
+
+  if (entry.sequence_number == (stamp_t)seq) {
+    std::memcpy(ret_data, &entry.data, sizeof(DataType));
+    if (ret_write_tsc) { *ret_write_tsc = write_tsc; }
+  }
+  return expand_stamp(entry.sequence_number, seq);
+}
+
+template<typename DataType, unsigned length, unsigned version_granularity, unsigned flags>
+uint64_t RingBuf<DataType, length, version_granularity, flags>::peek_sequence_number(uint64_t seq) {
+  std::atomic<uint64_t>& version_number = version_numbers[(seq - 1) & (version_granularity - 1)].number;
+  const versioned_DataType& slot = buf[(seq - 1) & (length - 1)];
+
+  uint64_t version_before;
+  stamp_t stamp;
+  do { // see consume()
+    version_before = version_number.load(std::memory_order_acquire);
+    stamp = __atomic_load_n(&slot.sequence_number, __ATOMIC_RELAXED);
+    std::atomic_thread_fence(std::memory_order_acquire);
+  } while ((uint32_t)version_before || version_number.load(std::memory_order_relaxed) != version_before);
+  return expand_stamp(stamp, seq);
+}
+
+template<typename DataType, unsigned length, unsigned version_granularity, unsigned flags>
+uint64_t RingBuf<DataType, length, version_granularity, flags>::recover() {
+  auto full = [this](stamp_t stamp) { return expand_stamp(stamp, read_sequence_number); }; // every stamp is within length of the reader
+  /* A writer that died holding a region claimed a sequence number at or below the global write 
+  sequence number and may have died anywhere in its write. Its slot is stamped only once the entry 
+  is complete (see write()), so in a held region a slot stamped with the newest sequence number 
+  claimed for it is kept, and any other stamp belongs to an entry that may be partly overwritten 
+  and is made to read as unwritten.
+  */
+  const uint64_t claimed = prod_u.atomic_global_write_sequence_number.load(std::memory_order_relaxed);
+  for (unsigned version_idx = 0; version_idx < version_granularity; ++version_idx) {
+    std::atomic<uint64_t>& version_number = version_numbers[version_idx].number;
+    if ((uint32_t)version_number.load(std::memory_order_relaxed)) { // refcount: writers that died holding the region
+      for (unsigned i = version_idx; i < length && i < claimed; i += version_granularity) {
+        const uint64_t newest_claim = claimed - ((claimed - 1 - i) & (length - 1)); // of the slot
+        if (full(buf[i].sequence_number) != newest_claim) {
+          buf[i].sequence_number = (stamp_t)(newest_claim > length ? newest_claim - length : 0); // a lap earlier reads as unwritten
+        }
+      }
+    }
+    version_number.store(0, std::memory_order_relaxed);
+  }
+
+  uint64_t newest_sequence_number = read_sequence_number; // never hand out a sequence number the reader already passed
+  for (const versioned_DataType& entry : buf) { newest_sequence_number = std::max(newest_sequence_number, full(entry.sequence_number)); }
+  prod_u.atomic_global_write_sequence_number.store(newest_sequence_number, std::memory_order_relaxed);
+  this->rebuild_dense_stamps(buf, full);
+  std::atomic_thread_fence(std::memory_order_release);
+  return newest_sequence_number;
+}
+
+template<typename DataType, unsigned length, unsigned version_granularity, unsigned flags>
+typename RingBuf<DataType, length, version_granularity, flags>::Reservation RingBuf<DataType, length, version_granularity, flags>::reserve() {
+  const Claim claimed = claim(1);
+  std::atomic_thread_fence(std::memory_order_release); // the claim is visible before anything constructed in the slot
+  return Reservation{ reinterpret_cast<DataType*>(&buf[(claimed.sequence_number - 1) & (length - 1)].data), claimed.sequence_number, claimed.version_number };
+}
+
+template<typename DataType, unsigned length, unsigned version_granularity, unsigned flags>
+void RingBuf<DataType, length, version_granularity, flags>::commit(const Reservation& reservation) {
+  versioned_DataType& slot = buf[(reservation.sequence_number - 1) & (length - 1)];
+  std::atomic_signal_fence(std::memory_order_seq_cst); // the entry is complete before it is stamped, see write()
+  __atomic_store_n(&slot.sequence_number, (stamp_t)reservation.sequence_number, __ATOMIC_RELAXED);
+  this->stamp_write_time(slot, reservation.sequence_number);
+  this->publish_dense_stamp(reservation.sequence_number);
+  reservation.version_number->fetch_add((uint64_t(1) << 32) - 1, std::memory_order_release);
+  RING_BUF_PROBE2(write_commit, this, reservation.sequence_number);
+}
+
+template<typename DataType, unsigned length, unsigned version_granularity, unsigned flags>
+template<typename F>
+bool RingBuf<DataType, length, version_granularity, flags>::consume(F&& on_entry) {
+  const unsigned version_idx = read_sequence_number & (version_granularity - 1);
+  std::atomic<uint64_t>& version_number = version_numbers[version_idx].number;
+  versioned_DataType& slot = buf[read_sequence_number & (length - 1)];
+
+  /* Unlike read(), the entry is not copied speculatively: only its sequence number is checked 
+  under the version number. Once that shows a committed entry, the slot belongs to the consumer 
+  until the writers come around again, which is not expected (see write()).
+  */
+  uint64_t attempts = 0; // dead unless RING_BUF_COUNTERS or the SDT probes are enabled
+  uint64_t version_before;
+  stamp_t sequence_number;
+  uint64_t write_tsc; // dead without RING_BUF_LATENCY
+  do {
+    ++attempts;
+    version_before = version_number.load(std::memory_order_acquire);
+    sequence_number = __atomic_load_n(&slot.sequence_number, __ATOMIC_RELAXED);
+    write_tsc = this->write_time(slot, read_sequence_number + 1);
+    std::atomic_thread_fence(std::memory_order_acquire);
+  } while ((uint32_t)version_before || version_number.load(std::memory_order_relaxed) != version_before);
+  this->count_torn_read_retries(attempts - 1);
+  if (attempts > 1) { RING_BUF_PROBE3(read_retry, this, read_sequence_number + 1, attempts - 1); }
+
+  if (!stamp_after(sequence_number, read_sequence_number)) { // same test as read()
+    this->count_failed_read();
+    RING_BUF_PROBE2(read_empty, this, read_sequence_number + 1);
+    return false;
+  }
+  DataType* entry = std::launder(reinterpret_cast<DataType*>(&slot.data));
+  this->record_latency(write_tsc);
+  on_entry(std::move(*entry));
+  entry->~DataType();
+  ++read_sequence_number;
+  RING_BUF_PROBE2(read_success, this, read_sequence_number);
+  return true;
+}
+
+template<typename DataType, unsigned length, unsigned version_granularity, unsigned flags>
+DataType* RingBuf<DataType, length, version_granularity, flags>::front(unsigned ahead) {
+  const uint64_t sequence_number = read_sequence_number + ahead; // of the entry before the wanted one
+  std::atomic<uint64_t>& version_number = version_numbers[sequence_number & (version_granularity - 1)].number;
+  versioned_DataType& slot = buf[sequence_number & (length - 1)];
+
+  uint64_t version_before;
+  stamp_t stamp;
+  do { // see consume()
+    version_before = version_number.load(std::memory_order_acquire);
+    stamp = __atomic_load_n(&slot.sequence_number, __ATOMIC_RELAXED);
+    std::atomic_thread_fence(std::memory_order_acquire);
+  } while ((uint32_t)version_before || version_number.load(std::memory_order_relaxed) != version_before);
+
+  if (!stamp_after(stamp, sequence_number)) { return nullptr; }
+  return std::launder(reinterpret_cast<DataType*>(&slot.data));
+}
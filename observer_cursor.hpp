@@ -0,0 +1,61 @@
+#pragma once
+#include "ring_buf.hpp"
+
+/* Read-only cursor over a live RingBuf for monitoring, sampling and debug taps. It copies entries
+with RingBuf::peek(), i.e., the same torn-read protection as read(), and never writes to the ring,
+so it cannot slow down or disturb the consumer (beyond sharing the cache lines it reads).
+Any number of cursors may watch a ring, each from its own thread.
+
+An observer either runs alongside the consumer (and the writers, so it may see an entry before the
+consumer does) or behind_consumer, in which case it only returns entries the consumer has already
+read. If the writers lap the cursor, the overwritten entries are counted in missed and the cursor
+jumps to the oldest entry still in the buffer.
+*/
+template<typename DataType, unsigned length, unsigned version_granularity = length, unsigned flags = 0>
+struct ObserverCursor {
+  using Ring = RingBuf<DataType, length, version_granularity, flags>;
+
+  Ring* ring;
+  uint64_t next_sequence_number; // sequence number of the next entry to observe (the first written entry is 1)
+  uint64_t missed;
+  bool behind_consumer;
+
+  // the ring's fields are written by other threads; both are 64-bit aligned so a relaxed load is never torn
+  uint64_t written_sequence_number() const { return __atomic_load_n(&ring->prod_u.write_sequence_number, __ATOMIC_RELAXED); }
+  uint64_t consumed_sequence_number() const { return __atomic_load_n(&ring->read_sequence_number, __ATOMIC_RELAXED); }
+
+  /* Returns whether an entry was observed; if so, it is in ret_data and ret_sequence_number, and
+  with RING_BUF_LATENCY its write time in ret_write_tsc (if not null), see RingBuf::peek().
+  */
+  bool next(DataType* ret_data, uint64_t* ret_sequence_number, uint64_t* ret_write_tsc = nullptr) {
+    for (;;) {
+      if (behind_consumer && next_sequence_number > consumed_sequence_number()) { return false; }
+      const uint64_t found = ring->peek(next_sequence_number, ret_data, ret_write_tsc);
+      if (found == next_sequence_number) {
+        *ret_sequence_number = next_sequence_number++;
+        return true;
+      }
+      if (found < next_sequence_number) { return false; } // not written yet
+
+      // lapped: everything up to found - length is gone
+      const uint64_t oldest_retained = found - length + 1;
+      missed += oldest_retained - next_sequence_number;
+      next_sequence_number = oldest_retained;
+    }
+  }
+
+  // entries written but not observed yet
+  uint64_t lag() const {
+    const uint64_t written = written_sequence_number();
+    return written >= next_sequence_number ? written - next_sequence_number + 1 : 0;
+  }
+
+  // skip to the entry after the newest one, e.g., to take one sample now and then
+  void skip_to_newest() { next_sequence_number = (behind_consumer ? consumed_sequence_number() : written_sequence_number()) + 1; }
+
+  // starts at the consumer's position, so the first entry observed is the next one it will read
+  ObserverCursor(Ring* ring, bool behind_consumer = false)
+    : ring(ring), next_sequence_number(0), missed(0), behind_consumer(behind_consumer) {
+    next_sequence_number = consumed_sequence_number() + 1;
+  }
+};
@@ -0,0 +1,102 @@
+#pragma once
+#include "ring_buf.hpp"
+
+/* Parallel processing of a ring's entries with the results still coming out in input order. The
+consumer thread dispatch()es each input to a pool of num_workers workers, round robin over one
+SPSC RingBuf per worker (include spsc.cpp), numbering inputs as it goes. A worker process()es its
+input straight into the reorder ring slot of that position and marks the slot ready. emit() then
+hands ready results to on_output in position order, as far as they are contiguous.
+
+emit() can be called from a sequencer thread of its own or by every worker right after it
+completed a position (work() with an on_output), whichever suits. Only one thread emits at a
+time: the others skip emitting instead of waiting, and the emitting thread looks again after it
+stepped down, so a result published meanwhile is not stranded.
+
+At most window positions are in flight. dispatch() returns false while the oldest one is not
+emitted yet, so one slow input holds back the window, but never the order. Results are emitted
+from their slot; on_output may move from it.
+*/
+template<typename In, typename Out, unsigned num_workers, unsigned window, unsigned flags = 0>
+struct OrderedWorkers {
+  static_assert(num_workers, "there must be at least one worker");
+  static_assert(window && !(window & (window - 1)), "window must be a power of 2");
+  static_assert(std::is_trivially_copyable_v<In>, "In must be POD (to support memcpy)");
+
+  struct __task {
+    uint64_t position;
+    In input;
+  };
+  using Lane = RingBuf<__task, window, window, flags>; // at most window tasks in flight, so a lane cannot overflow
+
+  struct alignas(ALIGN_NO_FALSE_SHARING) __reorder_slot {
+    std::atomic<uint64_t> ready; // position + 1 once the result for position is in
+    Out result;
+  };
+
+  Lane lanes[num_workers];
+  __reorder_slot reorder[window];
+  alignas(ALIGN_NO_FALSE_SHARING) std::atomic<uint64_t> next_emit_position; // written by the emitting thread
+  alignas(ALIGN_NO_FALSE_SHARING) std::atomic<bool> emitting;
+  // dispatcher only
+  alignas(ALIGN_NO_FALSE_SHARING) uint64_t next_position;
+  unsigned next_worker;
+
+  // Consumer thread: returns false, dispatching nothing, if window positions are in flight.
+  bool dispatch(const In* input) {
+    if (next_position - next_emit_position.load(std::memory_order_acquire) >= window) { return false; }
+    __task task;
+    task.position = next_position++;
+    std::memcpy(&task.input, input, sizeof(In));
+    lanes[next_worker].write(&task);
+    next_worker = next_worker + 1 < num_workers ? next_worker + 1 : 0;
+    return true;
+  }
+
+  /* Worker thread: calls process(const In&, Out*) for the next input of worker, if there is one,
+  and publishes the result. Returns whether there was an input.
+  */
+  template<typename F>
+  bool work(unsigned worker, F&& process) {
+    __task task;
+    if (!lanes[worker].read(&task)) { return false; }
+    __reorder_slot& slot = reorder[task.position & (window - 1)];
+    process(static_cast<const In&>(task.input), &slot.result);
+    slot.ready.store(task.position + 1, std::memory_order_seq_cst); // seq_cst: see emit()
+    return true;
+  }
+
+  // work() that then emits in the worker's thread, instead of a sequencer
+  template<typename F, typename G>
+  bool work(unsigned worker, F&& process, G&& on_output) {
+    if (!work(worker, std::forward<F>(process))) { return false; }
+    emit(std::forward<G>(on_output));
+    return true;
+  }
+
+  /* Calls on_output(Out&) for the ready results in position order and returns how many; 0 also
+  if another thread is emitting.
+  */
+  template<typename G>
+  unsigned emit(G&& on_output) {
+    unsigned emitted = 0;
+    for (;;) {
+      if (emitting.exchange(true, std::memory_order_seq_cst)) { return emitted; }
+      uint64_t position = next_emit_position.load(std::memory_order_relaxed);
+      __reorder_slot* slot;
+      while ((slot = &reorder[position & (window - 1)])->ready.load(std::memory_order_acquire) == position + 1) {
+        on_output(slot->result);
+        next_emit_position.store(++position, std::memory_order_release); // frees the slot for dispatch()
+        ++emitted;
+      }
+      emitting.store(false, std::memory_order_seq_cst);
+      /* A worker that published position after the check above found emitting set and left; with
+      its seq_cst store and exchange, either it sees the flag cleared here or this sees its result.
+      */
+      if (slot->ready.load(std::memory_order_seq_cst) != position + 1) { return emitted; }
+    }
+  }
+
+  OrderedWorkers() : next_emit_position(0), emitting(false), next_position(0), next_worker(0) {
+    for (__reorder_slot& slot : reorder) { slot.ready.store(0, std::memory_order_relaxed); }
+  }
+};
@@ -0,0 +1,125 @@
+#pragma once
+#include "ring_buf.hpp"
+
+/* mbuf-style packet buffers: a pool of fixed-size buffers that stages pass around as small
+PacketDescriptors over RingBufs instead of copying packet bytes. A descriptor names a buffer and
+the packet's offset and length in it; every buffer starts its packet headroom bytes in, so a stage
+can prepend a header (or strip one, or append a trailer) by adjusting the descriptor, without
+moving the payload. The last tailroom bytes of every buffer are kept free by append() and are only
+handed out by append_trailer(), so a trailer always fits behind a packet that filled its buffer.
+
+Buffers are reference counted, so one packet can be queued to several stages (retain() before
+passing a descriptor on, e.g., to mirror it); the last release() sends the buffer back over the
+pool's free ring. The allocating stage is the free ring's reader and every releasing stage one of
+its writers, so include mpsc.cpp if buffers are released by more than one thread. The free ring
+is at least num_buffers long and never holds more than num_buffers entries, so it cannot overflow.
+A RingBuf overwrites when full, and an overwritten descriptor leaks its buffer, so size each
+PacketRing for every descriptor that can be in flight on it (num_buffers bounds that).
+*/
+struct PacketDescriptor {
+  uint32_t buffer_index;
+  uint16_t data_offset; // from the start of the buffer
+  uint16_t data_length;
+};
+
+template<unsigned buffer_size, unsigned num_buffers, unsigned headroom = 128, unsigned tailroom = 0>
+struct PacketPool {
+  static_assert(buffer_size <= UINT16_MAX, "offsets and lengths are 16-bit");
+  static_assert(headroom + tailroom < buffer_size, "headroom and tailroom leave no room for data");
+  static_assert(num_buffers, "the pool needs buffers");
+
+  // what a stage that fills a fresh buffer (e.g., receive) may append while keeping the tailroom
+  static constexpr unsigned data_room = buffer_size - headroom - tailroom;
+
+  static constexpr unsigned free_length() {
+    unsigned free_length = 1;
+    while (free_length < num_buffers) { free_length <<= 1; }
+    return free_length;
+  }
+  using FreeRing = RingBuf<uint32_t, free_length()>;
+
+  struct alignas(ALIGN_NO_FALSE_SHARING) __buffer {
+    unsigned char bytes[buffer_size];
+  };
+  struct alignas(ALIGN_NO_FALSE_SHARING) __buffer_refcount { // separate from the bytes, so a count update does not bounce a data line
+    std::atomic<uint32_t> refcount;
+  };
+
+  __buffer buffers[num_buffers];
+  __buffer_refcount refcounts[num_buffers];
+  FreeRing free_ring;
+
+  // Allocating stage only: takes a buffer with an empty packet at headroom; false if the pool is empty.
+  bool alloc(PacketDescriptor* ret_descriptor) {
+    uint32_t buffer_index;
+    if (!free_ring.read(&buffer_index)) { return false; }
+    refcounts[buffer_index].refcount.store(1, std::memory_order_relaxed);
+    *ret_descriptor = PacketDescriptor{buffer_index, headroom, 0};
+    return true;
+  }
+
+  // one more owner for the descriptor's buffer
+  void retain(const PacketDescriptor& descriptor) { refcounts[descriptor.buffer_index].refcount.fetch_add(1, std::memory_order_relaxed); }
+
+  // gives up one owner's reference; the last one returns the buffer to the pool
+  void release(const PacketDescriptor& descriptor) {
+    if (refcounts[descriptor.buffer_index].refcount.fetch_sub(1, std::memory_order_acq_rel) != 1) { return; }
+    uint32_t buffer_index = descriptor.buffer_index;
+    free_ring.write(&buffer_index);
+  }
+
+  unsigned char* data(const PacketDescriptor& descriptor) { return buffers[descriptor.buffer_index].bytes + descriptor.data_offset; }
+  unsigned headroom_left(const PacketDescriptor& descriptor) const { return descriptor.data_offset; }
+  // room for append(), which leaves the reserved tailroom alone
+  unsigned tailroom_left(const PacketDescriptor& descriptor) const {
+    const unsigned end = descriptor.data_offset + descriptor.data_length;
+    return end < buffer_size - tailroom ? buffer_size - tailroom - end : 0;
+  }
+
+  /* Header and trailer adjustments; each returns where the caller writes (or, for strip, where the
+  removed bytes were), or nullptr, leaving the descriptor alone, if there is not enough room or data.
+  A buffer shared by several owners must not be modified, only its descriptors.
+  */
+  unsigned char* prepend(PacketDescriptor* descriptor, unsigned header_length) {
+    if (header_length > descriptor->data_offset) { return nullptr; }
+    descriptor->data_offset -= header_length;
+    descriptor->data_length += header_length;
+    return data(*descriptor);
+  }
+  unsigned char* strip(PacketDescriptor* descriptor, unsigned header_length) {
+    if (header_length > descriptor->data_length) { return nullptr; }
+    unsigned char* header = data(*descriptor);
+    descriptor->data_offset += header_length;
+    descriptor->data_length -= header_length;
+    return header;
+  }
+  unsigned char* append(PacketDescriptor* descriptor, unsigned trailer_length) {
+    if (trailer_length > tailroom_left(*descriptor)) { return nullptr; }
+    unsigned char* trailer = data(*descriptor) + descriptor->data_length;
+    descriptor->data_length += trailer_length;
+    return trailer;
+  }
+  unsigned char* append_trailer(PacketDescriptor* descriptor, unsigned trailer_length) { // may use the reserved tailroom
+    if (trailer_length > buffer_size - descriptor->data_offset - descriptor->data_length) { return nullptr; }
+    unsigned char* trailer = data(*descriptor) + descriptor->data_length;
+    descriptor->data_length += trailer_length;
+    return trailer;
+  }
+  unsigned char* trim(PacketDescriptor* descriptor, unsigned trailer_length) {
+    if (trailer_length > descriptor->data_length) { return nullptr; }
+    descriptor->data_length -= trailer_length;
+    return data(*descriptor) + descriptor->data_length;
+  }
+
+  // every buffer starts out in the free ring
+  PacketPool() {
+    for (uint32_t buffer_index = 0; buffer_index < num_buffers; ++buffer_index) {
+      refcounts[buffer_index].refcount.store(0, std::memory_order_relaxed);
+      free_ring.write(&buffer_index);
+    }
+  }
+};
+
+// descriptor ring between two stages of the packet path
+template<unsigned length, unsigned version_granularity = length, unsigned flags = 0>
+using PacketRing = RingBuf<PacketDescriptor, length, version_granularity, flags>;
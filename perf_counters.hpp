@@ -0,0 +1,88 @@
+#pragma once
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstdint>
+#include <cstdlib>
+
+/* Hardware counters of the calling thread, read through perf_event_open. Each event is opened
+on its own (not as a group) so that an event the CPU, VM or perf_event_paranoid setting does
+not allow is simply reported as unavailable instead of failing the whole set. Values are scaled
+by time_enabled / time_running in case the kernel multiplexed them.
+
+There is no generic HITM (load hit a modified line in another core's cache) event, so it is
+taken as a raw config from the RING_BENCH_HITM_EVENT environment variable, e.g.
+RING_BENCH_HITM_EVENT=0x4d2 for MEM_LOAD_L3_HIT_RETIRED.XSNP_HITM on Skylake through Ice Lake
+(see `perf list --details` for the current CPU).
+*/
+struct PerfCounters {
+  enum Event : unsigned { INSTRUCTIONS, CYCLES, CACHE_MISSES, L1D_READ_MISSES, DTLB_READ_MISSES, HITM, num_events };
+
+  static constexpr const char* event_names[num_events] = {
+    "instructions", "cycles", "cache-misses", "L1d-read-misses", "dTLB-read-misses", "HITM"
+  };
+
+  int fds[num_events];
+  double values[num_events];
+
+  static int open_event(uint32_t type, uint64_t config) {
+    perf_event_attr attr{};
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1; // also keeps it usable with perf_event_paranoid = 2
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(SYS_perf_event_open, &attr, 0 /* calling thread */, -1 /* any cpu */, -1, 0);
+  }
+
+  static constexpr uint64_t cache_config(uint64_t cache, uint64_t op, uint64_t result) {
+    return cache | (op << 8) | (result << 16);
+  }
+
+  bool available(Event event) const { return fds[event] >= 0; }
+
+  void start() {
+    for (int fd : fds) {
+      if (fd >= 0) {
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+      }
+    }
+  }
+
+  void stop() {
+    for (unsigned i = 0; i < num_events; ++i) {
+      values[i] = 0;
+      if (fds[i] < 0) { continue; }
+      ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+      uint64_t raw[3]; // value, time_enabled, time_running
+      if (::read(fds[i], raw, sizeof(raw)) != sizeof(raw)) { continue; }
+      values[i] = raw[2] ? (double)raw[0] * ((double)raw[1] / (double)raw[2]) : 0;
+    }
+  }
+
+  PerfCounters() {
+    fds[INSTRUCTIONS] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    fds[CYCLES] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    fds[CACHE_MISSES] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    fds[L1D_READ_MISSES] = open_event(PERF_TYPE_HW_CACHE,
+      cache_config(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS));
+    fds[DTLB_READ_MISSES] = open_event(PERF_TYPE_HW_CACHE,
+      cache_config(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS));
+    const char* hitm = std::getenv("RING_BENCH_HITM_EVENT");
+    fds[HITM] = hitm ? open_event(PERF_TYPE_RAW, std::strtoull(hitm, nullptr, 0)) : -1;
+    for (double& value : values) { value = 0; }
+  }
+
+  ~PerfCounters() {
+    for (int fd : fds) {
+      if (fd >= 0) { close(fd); }
+    }
+  }
+
+  PerfCounters(const PerfCounters&) = delete;
+  PerfCounters& operator=(const PerfCounters&) = delete;
+};
@@ -0,0 +1,57 @@
+#pragma once
+#include "ring_buf.hpp"
+
+/* Multi-lane channel with one RingBuf per priority; lane 0 is the most urgent. Producers write to
+a lane directly, so with spsc.cpp (one producer per lane) the producer side stays wait-free and a
+flooded bulk lane cannot delay a write to another lane. The single consumer picks lanes either
+
+  read_strict:   always the most urgent non-empty lane, so a cancel waits for at most the
+                 entry being processed, at the cost of starving lower lanes under load
+  read_weighted: up to weights[lane] entries from a lane before moving to the next one, so every
+                 lane gets a share; lane 0 may wait for one batch of each other lane
+
+Both return whether an entry was read and store its lane in ret_lane.
+*/
+template<typename DataType, unsigned length, unsigned num_lanes, unsigned version_granularity = length, unsigned flags = 0>
+struct PriorityLanes {
+  static_assert(num_lanes, "there must be at least one lane");
+
+  RingBuf<DataType, length, version_granularity, flags> lanes[num_lanes];
+  unsigned weights[num_lanes]; // read_weighted batch size per lane, at least 1
+
+  // consumer-only state of read_weighted
+  unsigned current_lane;
+  unsigned current_budget;
+
+  void write(unsigned lane, DataType* data) { lanes[lane].write(data); }
+
+  bool read_strict(DataType* ret_data, unsigned* ret_lane) {
+    for (unsigned lane = 0; lane < num_lanes; ++lane) {
+      if (lanes[lane].read(ret_data)) {
+        *ret_lane = lane;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool read_weighted(DataType* ret_data, unsigned* ret_lane) {
+    for (unsigned visited = 0; visited <= num_lanes; ++visited) { // <= so the starting lane is retried with a fresh budget
+      if (current_budget && lanes[current_lane].read(ret_data)) {
+        --current_budget;
+        *ret_lane = current_lane;
+        return true;
+      }
+      current_lane = current_lane + 1 < num_lanes ? current_lane + 1 : 0;
+      current_budget = weights[current_lane];
+    }
+    return false;
+  }
+
+  /* no budget yet, so the first read_weighted() moves on to lane 0 and loads its weight from
+  whatever the caller set after construction
+  */
+  PriorityLanes() : current_lane(num_lanes - 1), current_budget(0) {
+    for (unsigned lane = 0; lane < num_lanes; ++lane) { weights[lane] = 1; }
+  }
+};
@@ -5,19 +5,303 @@
 #include <type_traits>
 #include <numeric>
 #include <cstdint>
+#include <chrono>
+#include <new>
+#include <utility>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "hdr_histogram.hpp"
+#ifndef ALIGN_NO_FALSE_SHARING
 #define ALIGN_NO_FALSE_SHARING (64 * 2) // align to two cache lines because of prefetching
+#endif
+#ifndef RING_BUF_COUNTER_SLOTS
+#define RING_BUF_COUNTER_SLOTS 64 // per-ring counter blocks; must be a power of 2
+#endif
+
+/* SystemTap SDT static probes (provider "ring_buf"), usable from bpftrace/perf as 
+usdt:<binary>:ring_buf:<probe>. An SDT probe is a single nop plus a note section until a tracer 
+attaches, so they are compiled in whenever <sys/sdt.h> is available; define RING_BUF_NO_SDT to 
+drop them entirely. Every probe's first argument is the ring's address (its identity) and the 
+second is the sequence number it concerns:
+  write_claim(ring, seq)            producer owns seq's slot (after the CAS for MPSC)
+  write_retry(ring, seq, retries)   MPSC claim of seq needed this many extra CAS attempts
+  write_commit(ring, seq)           seq is published to the reader
+  read_success(ring, seq)           the reader consumed seq
+  read_empty(ring, seq)             seq was not written yet (or was stale)
+  read_retry(ring, seq, retries)    the reader re-copied seq's slot this many times
+Sequence numbers are the ones stored in the slots, i.e., the first written entry is 1.
+*/
+#if !defined(RING_BUF_NO_SDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define RING_BUF_PROBE2(name, ring, seq) DTRACE_PROBE2(ring_buf, name, ring, seq)
+#define RING_BUF_PROBE3(name, ring, seq, arg) DTRACE_PROBE3(ring_buf, name, ring, seq, arg)
+#endif
+#endif
+#ifndef RING_BUF_PROBE2
+#define RING_BUF_PROBE2(name, ring, seq) ((void)0)
+#define RING_BUF_PROBE3(name, ring, seq, arg) ((void)0)
+#endif
+
+/* Compile-time feature flags for RingBuf, OR'd together into its last template parameter.
+A feature that is not enabled adds no members and no instructions.
+*/
+enum RingBufFlags : unsigned {
+  RING_BUF_COUNTERS = 1u << 0, // per-thread hot-path counters, see counters_snapshot()
+  RING_BUF_LATENCY = 1u << 1, // write-to-read delay histogram, see latency_histogram
+  RING_BUF_DENSE_STAMPS = 1u << 2, // sequence numbers also kept 8 per cache line, see read_batch()
+  RING_BUF_STAMP32 = 1u << 3, // 32-bit slot stamps instead of 64-bit ones, see stamp_t
+  RING_BUF_STAMP16 = 1u << 4, // 16-bit slot stamps, length must be at most 2^15
+};
+
+// how the version numbers are used, for tools that inspect a ring from outside (see ring_descriptor.hpp)
+enum RingBufImplementation : unsigned {
+  RING_BUF_SPSC = 1, // odd while the region is being written
+  RING_BUF_MPSC = 2, // low 32 bits: writer refcount, high 32 bits: completed writes
+  RING_BUF_ROBUST_MPSC = 3, // low 32 bits: one bit per holding producer, high 32 bits: completed writes (robust_ring.hpp)
+};
+
+struct RingBufCounters {
+  uint64_t cas_retries; // failed compare_exchange_weak on the global write sequence number (MPSC)
+  uint64_t region_switches; // fetch_sub on a stale version number after a failed claim (MPSC)
+  uint64_t torn_read_retries; // repeated memcpy in read() because a writer held the region
+  uint64_t failed_reads; // read() calls that found no new entry
+};
+
+/* Each thread gets a small index on first use; a ring keeps one counter block per index so 
+that threads never write to the same cache line. If more than RING_BUF_COUNTER_SLOTS threads 
+touch a ring, indices wrap and colliding threads may lose increments, which is acceptable for 
+statistics and avoids an atomic read-modify-write on the hot path.
+*/
+inline unsigned __ring_buf_thread_slot() {
+  static std::atomic<unsigned> next_slot{0};
+  thread_local unsigned slot = next_slot.fetch_add(1, std::memory_order_relaxed) & (RING_BUF_COUNTER_SLOTS - 1);
+  return slot;
+}
+
+template<bool enabled>
+struct __ring_buf_counters { // disabled: empty base, every call compiles away
+  void count_cas_retries(uint64_t) {}
+  void count_region_switch() {}
+  void count_torn_read_retries(uint64_t) {}
+  void count_failed_read() {}
+  RingBufCounters counters_snapshot() const { return RingBufCounters{}; }
+};
+
+template<>
+struct __ring_buf_counters<true> {
+  static_assert(RING_BUF_COUNTER_SLOTS && !(RING_BUF_COUNTER_SLOTS & (RING_BUF_COUNTER_SLOTS - 1)), "RING_BUF_COUNTER_SLOTS must be a power of 2");
+
+  struct alignas(ALIGN_NO_FALSE_SHARING) __counter_block {
+    std::atomic<uint64_t> cas_retries;
+    std::atomic<uint64_t> region_switches;
+    std::atomic<uint64_t> torn_read_retries;
+    std::atomic<uint64_t> failed_reads;
+  };
+  __counter_block counter_blocks[RING_BUF_COUNTER_SLOTS];
+
+  // only the owning thread writes a block, so a relaxed load and store suffices (no lock prefix)
+  static void bump(std::atomic<uint64_t>& counter, uint64_t n) {
+    counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+  }
+  __counter_block& own_block() { return counter_blocks[__ring_buf_thread_slot()]; }
+
+  void count_cas_retries(uint64_t n) { if (n) { bump(own_block().cas_retries, n); } }
+  void count_region_switch() { bump(own_block().region_switches, 1); }
+  void count_torn_read_retries(uint64_t n) { if (n) { bump(own_block().torn_read_retries, n); } }
+  void count_failed_read() { bump(own_block().failed_reads, 1); }
+
+  // may be called from any thread; the sums are not a consistent cut across blocks
+  RingBufCounters counters_snapshot() const {
+    RingBufCounters total{};
+    for (const __counter_block& block : counter_blocks) {
+      total.cas_retries += block.cas_retries.load(std::memory_order_relaxed);
+      total.region_switches += block.region_switches.load(std::memory_order_relaxed);
+      total.torn_read_retries += block.torn_read_retries.load(std::memory_order_relaxed);
+      total.failed_reads += block.failed_reads.load(std::memory_order_relaxed);
+    }
+    return total;
+  }
+
+  __ring_buf_counters() {
+    for (__counter_block& block : counter_blocks) {
+      block.cas_retries.store(0, std::memory_order_relaxed);
+      block.region_switches.store(0, std::memory_order_relaxed);
+      block.torn_read_retries.store(0, std::memory_order_relaxed);
+      block.failed_reads.store(0, std::memory_order_relaxed);
+    }
+  }
+};
+
+// TSC ticks on x86 (constant_tsc is assumed), steady clock nanoseconds elsewhere
+inline uint64_t ring_buf_tsc() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+/* Slot layout of RingBuf<DataType, length, version_granularity, flags>, kept out of RingBuf so
+that its feature bases can depend on it; RingBuf re-exports every name.
+
+Slots hold a non-POD DataType as raw storage, constructed by emplace() and destroyed by consume(),
+so that the buffer itself stays trivially copyable; a POD DataType is stored as is. The stamp is
+described at RingBuf::stamp_t.
+*/
+template<typename DataType, unsigned flags>
+struct __ring_buf_slot_layout {
+  struct __raw_DataType {
+    alignas(DataType) unsigned char bytes[sizeof(DataType)];
+  };
+  using slot_DataType = std::conditional_t<std::is_trivially_copyable_v<DataType>, DataType, __raw_DataType>;
+  using stamp_t = std::conditional_t<(flags & RING_BUF_STAMP16) != 0, uint16_t, std::conditional_t<(flags & RING_BUF_STAMP32) != 0, uint32_t, uint64_t>>;
+
+  struct __unaligned_versioned_DataType {
+    slot_DataType data;
+    stamp_t sequence_number;
+  };
+  static constexpr unsigned align_to_no_false_sharing() {
+    unsigned gcd = ALIGN_NO_FALSE_SHARING;
+    while (sizeof(__unaligned_versioned_DataType) % gcd && ALIGN_NO_FALSE_SHARING % gcd) {
+      gcd >>= 1; // < ALIGN_NO_FALSE_SHARING is always a power of 2
+    }
+
+    unsigned lcm_alignment = (sizeof(__unaligned_versioned_DataType) / gcd) * ALIGN_NO_FALSE_SHARING; // divide by gcd first to avoid overflow
+    unsigned final_alignment = 1;
+    while (final_alignment < lcm_alignment) { final_alignment <<= 1; }
+    return final_alignment;
+  }
+  struct alignas(align_to_no_false_sharing()) __plain_versioned_DataType {
+    slot_DataType data;
+    stamp_t sequence_number;
+  };
+  struct alignas(align_to_no_false_sharing()) __timed_versioned_DataType { // see __ring_buf_latency
+    slot_DataType data;
+    stamp_t sequence_number;
+    uint64_t write_tsc;
+  };
+  // with RING_BUF_LATENCY, the write time goes in the slot's alignment padding whenever it fits there
+  static constexpr bool write_tsc_in_slot = (flags & RING_BUF_LATENCY) && sizeof(__timed_versioned_DataType) == sizeof(__plain_versioned_DataType);
+  using versioned_DataType = std::conditional_t<write_tsc_in_slot, __timed_versioned_DataType, __plain_versioned_DataType>;
+};
+
+template<bool enabled, bool write_tsc_in_slot, unsigned length>
+struct __ring_buf_latency { // disabled: empty base, every call compiles away
+  template<typename Slot> void stamp_write_time(Slot&, uint64_t) {}
+  template<typename Slot> uint64_t write_time(const Slot&, uint64_t) const { return 0; }
+  void record_latency(uint64_t) {}
+};
+
+/* The producer stamps ring_buf_tsc() into the slot before it releases the version number, the
+consumer loads the stamp under the same version check as the entry, and after each successful
+read it records read time - write time, in ticks of ring_buf_tsc(). Only the consumer records,
+so the histogram's single-writer rule holds for MPSC too, and any thread may read percentiles
+from latency_histogram while the ring is live.
+
+The stamp lives in the slot's alignment padding (versioned_DataType::write_tsc), so it rides on
+the cache lines the slot moves anyway and the slot does not grow. Slots without 8 spare bytes of
+padding use the side array below instead.
+*/
+template<unsigned length>
+struct __ring_buf_latency<true, true, length> {
+  LogLinearHistogram<> latency_histogram;
+
+  template<typename Slot> void stamp_write_time(Slot& slot, uint64_t) { __atomic_store_n(&slot.write_tsc, ring_buf_tsc(), __ATOMIC_RELAXED); }
+  // only meaningful under the version check of the slot's region, like the slot itself
+  template<typename Slot> uint64_t write_time(const Slot& slot, uint64_t) const { return __atomic_load_n(&slot.write_tsc, __ATOMIC_RELAXED); }
+  void record_latency(uint64_t write_tsc) { latency_histogram.record(ring_buf_tsc() - write_tsc); }
+};
+
+/* Fallback for slots that the stamp would grow: the stamps go in a side array indexed like the
+slots. The slot keeps its size, but the array costs length * 8 bytes and one more cache line per
+write and per read, and the producer and the consumer share that line while they are within 8
+entries of each other.
+*/
+template<unsigned length>
+struct __ring_buf_latency<true, false, length> {
+  LogLinearHistogram<> latency_histogram;
+  alignas(ALIGN_NO_FALSE_SHARING) uint64_t write_tscs[length];
+
+  template<typename Slot> void stamp_write_time(Slot&, uint64_t seq) { __atomic_store_n(&write_tscs[(seq - 1) & (length - 1)], ring_buf_tsc(), __ATOMIC_RELAXED); }
+  template<typename Slot> uint64_t write_time(const Slot&, uint64_t seq) const { return __atomic_load_n(&write_tscs[(seq - 1) & (length - 1)], __ATOMIC_RELAXED); }
+  void record_latency(uint64_t write_tsc) { latency_histogram.record(ring_buf_tsc() - write_tsc); }
+
+  __ring_buf_latency() {
+    for (uint64_t& write_tsc : write_tscs) { write_tsc = 0; }
+  }
+};
+
+template<bool enabled, unsigned length>
+struct __ring_buf_dense_stamps { // disabled: empty base, every call compiles away
+  void publish_dense_stamp(uint64_t) {}
+  template<typename Slot, typename Expand> void rebuild_dense_stamps(const Slot*, Expand&&) {}
+  unsigned ready_count(uint64_t, unsigned max_count) const { return max_count; }
+};
+
+/* A copy of every slot's sequence number in one dense array, so that the consumer can find out how 
+many of the next slots are ready by comparing 4 stamps per instruction (one cache line covers 8 
+slots) without touching any payload line. The writer updates it after copying the slot and before 
+releasing the version number; the consumer treats it only as a hint and still validates each entry 
+with read(), so a stale or early stamp can only shorten or end a batch.
+*/
+template<unsigned length>
+struct __ring_buf_dense_stamps<true, length> {
+  alignas(ALIGN_NO_FALSE_SHARING) uint64_t dense_sequence_numbers[length];
+
+  void publish_dense_stamp(uint64_t seq) {
+    __atomic_store_n(&dense_sequence_numbers[(seq - 1) & (length - 1)], seq, __ATOMIC_RELAXED);
+  }
+
+  // expand(stamp) turns a slot's (possibly compact) stamp back into a full sequence number
+  template<typename Slot, typename Expand>
+  void rebuild_dense_stamps(const Slot* slots, Expand&& expand) {
+    for (unsigned i = 0; i < length; ++i) { dense_sequence_numbers[i] = expand(slots[i].sequence_number); }
+  }
+
+  // number of consecutive slots, up to max_count, that hold read_sequence_number + 1, + 2, ...
+  unsigned ready_count(uint64_t read_sequence_number, unsigned max_count) const {
+    typedef uint64_t __stamp_vector __attribute__((vector_size(4 * sizeof(uint64_t)))); // one AVX2 compare, or two SSE ones
+    uint64_t expected = read_sequence_number + 1;
+    unsigned ready = 0;
+    for (;;) {
+      const unsigned idx = (expected - 1) & (length - 1);
+      if (ready + 4 > max_count || idx + 4 > length) { break; } // the tail and the wrap point go one by one
+      __stamp_vector stamps;
+      std::memcpy(&stamps, &dense_sequence_numbers[idx], sizeof(stamps));
+      const __stamp_vector want = {expected, expected + 1, expected + 2, expected + 3};
+      const __stamp_vector equal = stamps == want; // all ones in lanes that match
+      if (!(equal[0] & equal[1] & equal[2] & equal[3])) { break; }
+      ready += 4;
+      expected += 4;
+    }
+    while (ready < max_count && __atomic_load_n(&dense_sequence_numbers[(expected - 1) & (length - 1)], __ATOMIC_RELAXED) == expected) {
+      ++ready;
+      ++expected;
+    }
+    return ready;
+  }
+
+  __ring_buf_dense_stamps() {
+    for (uint64_t& stamp : dense_sequence_numbers) { stamp = 0; }
+  }
+};
 
 /* Lock-free ring buffer with SPSC and MPSC implementations. Typically only a single 
 consumer exists. The writer is in fact wait-free in the SPSC case. The length and version 
 granularity must be powers of 2 to make modulo as fast as possible, and version_granularity
-must divide length (i.e., be <= length). Finally, DataType should be a POD struct.
+must divide length (i.e., be <= length). Finally, DataType should be a POD struct for write() 
+and read(); any other type, including move-only ones, goes through reserve()/commit() or emplace() 
+and consume() instead. Optional features are selected with RingBufFlags in flags.
 */
-template<typename DataType, unsigned length, unsigned version_granularity = length>
-struct RingBuf {
+template<typename DataType, unsigned length, unsigned version_granularity = length, unsigned flags = 0>
+struct RingBuf : __ring_buf_counters<(flags & RING_BUF_COUNTERS) != 0>,
+  __ring_buf_latency<(flags & RING_BUF_LATENCY) != 0, __ring_buf_slot_layout<DataType, flags>::write_tsc_in_slot, length>,
+  __ring_buf_dense_stamps<(flags & RING_BUF_DENSE_STAMPS) != 0, length> {
   static_assert(length && !(length & (length - 1)), "length must be a power of 2");
   static_assert(version_granularity && !(version_granularity & (version_granularity - 1)), "version granularity must be a power of 2");
   static_assert(!(length & (version_granularity - 1)), "version granularity must divide length");
-  static_assert(std::is_trivially_copyable_v<DataType>, "DataType must be POD (to support memcpy)");
 
   union // union members are not automatically wrapped because each is needed to detect unwritten/stale entries for MPSC or SPSC
   {
@@ -40,29 +324,40 @@ struct RingBuf {
   For MP, a version number is 1 if its rewriter always adds to a version number to take control of it but subtracts when
   relinquishing control of the region to the reader. This is because a producer may have 
   incremented the version number on a stale append region, so it must later correct it. 
-  Hence, in MP, a version number is actually a writer refcount.
+  Hence, in MP, a version number is actually a writer refcount. The refcount lives in the low 
+  32 bits; the final release of a write also adds 1 to the upper 32 bits (a single fetch_add of 
+  2^32 - 1), so the reader can tell that a write started and finished while it was copying a slot, 
+  which a bare refcount cannot show.
   */
   __version_alignment_wrapper version_numbers[version_granularity];
 
-  struct __unaligned_versioned_DataType {
-    DataType data;
-    uint64_t sequence_number;
-  };
-  static constexpr unsigned align_to_no_false_sharing() {
-    unsigned gcd = ALIGN_NO_FALSE_SHARING;
-    while (sizeof(__unaligned_versioned_DataType) % gcd && ALIGN_NO_FALSE_SHARING % gcd) { 
-      gcd >>= 1; // < ALIGN_NO_FALSE_SHARING is always a power of 2
-    } 
+  using __slot_layout = __ring_buf_slot_layout<DataType, flags>; // slot types, see there
+  using slot_DataType = typename __slot_layout::slot_DataType;
 
-    unsigned lcm_alignment = (sizeof(__unaligned_versioned_DataType) / gcd) * ALIGN_NO_FALSE_SHARING; // divide by gcd first to avoid overflow
-    unsigned final_alignment = 1;
-    while (final_alignment < lcm_alignment) { final_alignment <<= 1; }
-    return final_alignment;
+  /* Slot stamps. By default a slot stores its full 64-bit sequence number. With RING_BUF_STAMP32 or 
+  RING_BUF_STAMP16 it stores only the low 32 or 16 bits, which shrinks the slot, e.g., a 60-byte 
+  DataType of 32-bit fields and a 32-bit stamp fit one 64-byte line instead of a 72-byte slot. 
+  The full number is never needed from the slot alone: the reader compares a stamp with the 
+  sequence number it expects, which is always within length of the stamp unless writers lap the 
+  reader (not expected, see write()), so the comparisons are exact while length is at most half 
+  the stamp range.
+  */
+  static constexpr bool compact_stamps = (flags & (RING_BUF_STAMP32 | RING_BUF_STAMP16)) != 0;
+  static_assert((flags & (RING_BUF_STAMP32 | RING_BUF_STAMP16)) != (RING_BUF_STAMP32 | RING_BUF_STAMP16), "pick one stamp width");
+  using stamp_t = typename __slot_layout::stamp_t;
+  static constexpr unsigned stamp_bits = 8 * sizeof(stamp_t);
+  static_assert(!compact_stamps || length <= (uint64_t)1 << (stamp_bits - 1), "length must be at most half the stamp range");
+
+  // 1 iff the entry stamped stamp is newer than seq (stamp > seq modulo the stamp width), without a branch
+  static unsigned char stamp_after(stamp_t stamp, uint64_t seq) { return (stamp_t)((stamp_t)seq - stamp) >> (stamp_bits - 1); }
+  // the full sequence number nearest to near whose low bits are stamp
+  static uint64_t expand_stamp(stamp_t stamp, uint64_t near) {
+    return near + (int64_t)(std::make_signed_t<stamp_t>)(stamp_t)(stamp - (stamp_t)near);
   }
-  struct alignas(align_to_no_false_sharing()) versioned_DataType {
-    DataType data;
-    uint64_t sequence_number;
-  };
+
+  using __unaligned_versioned_DataType = typename __slot_layout::__unaligned_versioned_DataType;
+  static constexpr unsigned align_to_no_false_sharing() { return __slot_layout::align_to_no_false_sharing(); }
+  using versioned_DataType = typename __slot_layout::versioned_DataType; // plus write_tsc with RING_BUF_LATENCY, see __ring_buf_latency
   // underlying buffer
   versioned_DataType buf[length];
   
@@ -81,5 +376,131 @@ struct RingBuf {
   */
   bool read(DataType* ret_data);
 
+  /* Reads up to max_count consecutive entries into ret_data[0..) and returns how many were read. 
+  With RING_BUF_DENSE_STAMPS, the dense stamps tell up front how many entries are ready, so an 
+  empty or short ring costs a look at one stamp line instead of a copy of the next slot.
+  */
+  unsigned read_batch(DataType* ret_data, unsigned max_count);
+
+  /* Copies the entry whose sequence number is seq (as stored in the slots, so the first written 
+  entry is 1) into ret_data without consuming it, with the same torn-read protection as read(). 
+  Returns the sequence number that was actually found in seq's slot: seq on success (only then is 
+  ret_data written), less than seq if seq was not written yet and greater than seq if it was 
+  already overwritten. Any thread may peek while the ring is in use. With compact stamps, the 
+  found sequence number is only exact within half the stamp range of seq. With RING_BUF_LATENCY, 
+  ret_write_tsc (if not null) receives the entry's write time on success, read under the same 
+  check as the entry.
+  */
+  uint64_t peek(uint64_t seq, DataType* ret_data, uint64_t* ret_write_tsc = nullptr);
+  // Like peek(), but only checks the stamp: copies nothing and works for any DataType.
+  uint64_t peek_sequence_number(uint64_t seq);
+
+  /* Consumer only: moves the reader so that the next read() returns the entry with sequence number 
+  seq (see peek()), e.g., to re-process a batch from a checkpoint after the consumer restarted. 
+  seq may also be the entry after the newest one written (the reader then waits for it), but no 
+  later one. Returns false and leaves the reader where it was if seq is 0, beyond that or was 
+  already overwritten; for an overwritten seq the caller has to recover the range from elsewhere. 
+  On success, intact (if not null) receives how many entries from seq on are committed in the 
+  buffer, counting up to the first one that is overwritten or not written yet; only their stamps 
+  are checked.
+  */
+  bool seek(uint64_t seq, uint64_t* intact = nullptr);
+
+  /* Two-phase write for DataTypes that cannot be memcpy'd, or to build an entry in place. reserve() 
+  claims the next slot exactly like write() and returns its uninitialized storage; the producer 
+  constructs a DataType there and then calls commit() to publish it. Until then the slot's region 
+  counts as being written, so keep the two close together. Every reservation must be committed.
+  */
+  struct Reservation {
+    DataType* data;
+    uint64_t sequence_number;
+    std::atomic<uint64_t>* version_number;
+  };
+  Reservation reserve();
+  void commit(const Reservation& reservation);
+
+  /* MPSC only: the claim shared by write(), reserve() and RobustRing::write(). Claims the next 
+  sequence number and holds its region by adding hold to the region's version number (1 to count 
+  a writer in the refcount, or a writer's own bit, see RobustRing). The claimed sequence number is 
+  published with claim_order. Returns the claimed sequence number, the held version number and 
+  its value before hold was added, on which the caller's copy into the slot depends.
+  */
+  struct Claim {
+    uint64_t sequence_number;
+    std::atomic<uint64_t>* version_number;
+    uint64_t version_before_hold;
+  };
+  Claim claim(uint64_t hold, std::memory_order claim_order = std::memory_order_relaxed);
+
+  // Constructs the entry in its slot; a throwing constructor would leave the slot claimed forever, hence noexcept.
+  template<typename... Args>
+  void emplace(Args&&... args) noexcept {
+    const Reservation reservation = reserve();
+    new (reservation.data) DataType(std::forward<Args>(args)...);
+    commit(reservation);
+  }
+
+  /* Counterpart of reserve()/emplace(): if the next entry is there, calls on_entry(DataType&&) on 
+  the object in its slot (no copy is made first, so on_entry may move from it) and then destroys 
+  it in place. Returns whether an entry was consumed. Entries that are never consumed are never 
+  destroyed either, so drain the ring before it goes away.
+  */
+  template<typename F>
+  bool consume(F&& on_entry);
+
+  // consume() that move-assigns the entry to *ret_data
+  bool take(DataType* ret_data) {
+    return consume([ret_data](DataType&& entry) { *ret_data = std::move(entry); });
+  }
+
+  /* Consumer only, zero-copy access: returns the committed entry ahead entries past the reader's 
+  position, in its slot, or nullptr if it is not written yet. Like consume(), only the sequence 
+  number is checked, so the entry stays valid until the writers come around again; pop() then 
+  releases entries in order. Entries are not destroyed, so use consume() for those built by emplace().
+  */
+  DataType* front(unsigned ahead = 0);
+  void pop(unsigned count = 1) {
+    read_sequence_number += count;
+    RING_BUF_PROBE2(read_success, this, read_sequence_number);
+  }
+
+  /* Makes a ring usable again after the process(es) using it died, e.g., when it lives in a file 
+  or shared memory mapping that outlives them. A writer that died mid-write leaves its region 
+  claimed and its slot possibly torn. Only that slot is invalidated, i.e., made to read as unwritten: 
+  for SPSC, the slot of the write sequence number, which is advanced before the region is claimed; 
+  for MPSC, any slot of a held region whose stamp is not the newest sequence number claimed for it, 
+  since writers stamp a slot only after its entry is complete. Committed entries are never dropped, 
+  but a dead MPSC writer leaves a gap that read() does not get past. Every region is released and 
+  the write sequence number is then restored to the newest sequence number left in the buffer (or 
+  already read, if that is newer). There must be no concurrent readers or writers. Returns that 
+  sequence number.
+  */
+  uint64_t recover();
+
+  static const RingBufImplementation implementation; // defined by spsc.cpp or mpsc.cpp
+
   RingBuf();
-};
\ No newline at end of file
+};
+
+// shared by the SPSC and MPSC implementations since it only relies on peek_sequence_number()
+template<typename DataType, unsigned length, unsigned version_granularity, unsigned flags>
+bool RingBuf<DataType, length, version_granularity, flags>::seek(uint64_t seq, uint64_t* intact) {
+  if (!seq || peek_sequence_number(seq) > seq) { return false; } // 0 is never written; a newer entry means seq was overwritten
+  // both union members are 64-bit aligned, so a relaxed load is never torn; claimed counts as written
+  if (seq > __atomic_load_n(&prod_u.write_sequence_number, __ATOMIC_RELAXED) + 1) { return false; } // would skip entries
+  if (intact) {
+    uint64_t count = 0;
+    while (count < length && peek_sequence_number(seq + count) == seq + count) { ++count; }
+    *intact = count;
+  }
+  read_sequence_number = seq - 1;
+  return true;
+}
+
+template<typename DataType, unsigned length, unsigned version_granularity, unsigned flags>
+unsigned RingBuf<DataType, length, version_granularity, flags>::read_batch(DataType* ret_data, unsigned max_count) {
+  const unsigned ready = this->ready_count(read_sequence_number, max_count);
+  unsigned count = 0;
+  while (count < ready && read(ret_data + count)) { ++count; }
+  return count;
+}
\ No newline at end of file
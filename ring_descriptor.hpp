@@ -0,0 +1,88 @@
+#pragma once
+#include "ring_buf.hpp"
+#include <cstddef>
+#include <typeinfo>
+
+/* Self-description of a RingBuf in a shared mapping, so that a tool that does not know the ring's
+template arguments (see ring_inspect.cpp) can find its sequence numbers, version numbers and slots.
+JournalRing and SharedRobustRing put one at offset 0 of their mapping; for a ring placed in a
+mapping by hand, fill one with describe_ring() at the start of the mapping. All offsets are in
+bytes, and the layout of this struct only changes together with descriptor_version.
+*/
+static constexpr uint64_t ring_buf_descriptor_magic = 0x4353454446554252; // "RBUFDESC"
+
+struct alignas(ALIGN_NO_FALSE_SHARING) RingBufDescriptor {
+  uint64_t magic; // ring_buf_descriptor_magic once the rest is filled in
+  uint32_t descriptor_version;
+  uint32_t implementation; // RingBufImplementation
+  uint64_t ring_offset; // from the start of the mapping
+  uint64_t ring_size;
+  uint32_t length;
+  uint32_t version_granularity;
+  uint32_t flags; // RingBufFlags
+  uint32_t data_size;
+  uint64_t write_sequence_offset; // this and the other *_offset fields are relative to the ring
+  uint64_t read_sequence_offset;
+  uint64_t versions_offset;
+  uint64_t slots_offset;
+  uint32_t version_stride;
+  uint32_t slot_stride;
+  uint32_t stamp_offset; // within a slot
+  uint32_t stamp_size; // 8, or 4/2 with compact stamps (the low bits of the sequence number)
+  uint32_t data_offset; // within a slot
+  uint32_t reserved;
+  char data_type[64]; // typeid(DataType).name(), truncated, so a decoder can check what it is given
+};
+
+static constexpr uint32_t ring_buf_descriptor_version = 1;
+
+template<typename DataType, unsigned length, unsigned version_granularity, unsigned flags>
+void describe_ring(RingBufDescriptor* descriptor, const RingBuf<DataType, length, version_granularity, flags>* ring,
+  const void* mapping, RingBufImplementation implementation) {
+  auto offset = [](const void* from, const void* to) { return (uint64_t)(static_cast<const char*>(to) - static_cast<const char*>(from)); };
+  descriptor->descriptor_version = ring_buf_descriptor_version;
+  descriptor->implementation = implementation;
+  descriptor->ring_offset = offset(mapping, ring);
+  descriptor->ring_size = sizeof(*ring);
+  descriptor->length = length;
+  descriptor->version_granularity = version_granularity;
+  descriptor->flags = flags;
+  descriptor->data_size = sizeof(DataType);
+  descriptor->write_sequence_offset = offset(ring, &ring->prod_u);
+  descriptor->read_sequence_offset = offset(ring, &ring->read_sequence_number);
+  descriptor->versions_offset = offset(ring, &ring->version_numbers[0]);
+  descriptor->slots_offset = offset(ring, &ring->buf[0]);
+  descriptor->version_stride = sizeof(ring->version_numbers[0]);
+  descriptor->slot_stride = sizeof(ring->buf[0]);
+  descriptor->stamp_offset = offset(&ring->buf[0], &ring->buf[0].sequence_number);
+  descriptor->stamp_size = sizeof(ring->buf[0].sequence_number);
+  descriptor->data_offset = offset(&ring->buf[0], &ring->buf[0].data);
+  descriptor->reserved = 0;
+  std::strncpy(descriptor->data_type, typeid(DataType).name(), sizeof(descriptor->data_type) - 1);
+  descriptor->data_type[sizeof(descriptor->data_type) - 1] = 0;
+  __atomic_store_n(&descriptor->magic, ring_buf_descriptor_magic, __ATOMIC_RELEASE);
+}
+
+/* Whether descriptor was filled by describe_ring() for this very ring type: implementation, length,
+version granularity, flags (hence stamp width), slot layout and DataType (by its type name, which
+also tells apart two types of the same size). Offsets relative to the mapping are not compared.
+*/
+template<typename DataType, unsigned length, unsigned version_granularity, unsigned flags>
+bool describes_ring(const RingBufDescriptor* descriptor, const RingBuf<DataType, length, version_granularity, flags>* ring,
+  RingBufImplementation implementation) {
+  RingBufDescriptor expected;
+  describe_ring(&expected, ring, ring, implementation);
+  return __atomic_load_n(&descriptor->magic, __ATOMIC_ACQUIRE) == ring_buf_descriptor_magic
+    && descriptor->descriptor_version == expected.descriptor_version && descriptor->implementation == expected.implementation
+    && descriptor->ring_size == expected.ring_size && descriptor->length == expected.length
+    && descriptor->version_granularity == expected.version_granularity && descriptor->flags == expected.flags
+    && descriptor->data_size == expected.data_size && descriptor->slot_stride == expected.slot_stride
+    && descriptor->stamp_size == expected.stamp_size && !std::strncmp(descriptor->data_type, expected.data_type, sizeof(expected.data_type));
+}
+
+/* Entry point of a ring_inspect decoder plug-in, a shared object exporting
+  extern "C" int ring_inspect_decode(const RingBufDescriptor*, uint64_t sequence_number, const void* data, char* out, size_t out_size);
+that writes a one-line rendering of the entry at data (descriptor->data_size bytes) to out and
+returns its length, or a negative number to fall back to a hex dump.
+*/
+typedef int (*ring_inspect_decode_fn)(const RingBufDescriptor* descriptor, uint64_t sequence_number, const void* data, char* out, size_t out_size);
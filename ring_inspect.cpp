@@ -0,0 +1,192 @@
+/* Live view of a RingBuf in a shared mapping, e.g., a JournalRing file or a SharedRobustRing in
+/dev/shm. The mapping is opened read-only, located through its RingBufDescriptor and never
+written, so attaching cannot disturb the ring. Every interval it prints one line:
+
+  write/read sequence numbers, lag (written but not read), write and read rates,
+  how many version regions are held by a writer and a verdict:
+    idle     nothing pending and nothing written during the interval
+    active   the reader made progress
+    stalled  entries are pending but the reader did not move during the interval
+  and, for a region that stays held with the same version number for a whole interval,
+  "stuck region <index> (<version>)" which points at a writer that stopped mid-write.
+
+With -n, the newest entries are dumped after each line as hex, or through a decoder plug-in
+given with -d (see ring_inspect_decode_fn in ring_descriptor.hpp). Entries are copied with the
+same version check as RingBuf::read() and marked torn if a writer got in the way.
+  g++ -std=c++17 -O2 ring_inspect.cpp -o ring_inspect -ldl
+Usage: ring_inspect [-i interval ms] [-n entries to dump] [-d decoder.so] [-c samples] <path>
+*/
+#include "ring_descriptor.hpp"
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+struct InspectedRing {
+  const RingBufDescriptor* descriptor;
+  const char* ring;
+
+  uint64_t write_sequence_number() const {
+    return __atomic_load_n(reinterpret_cast<const uint64_t*>(ring + descriptor->write_sequence_offset), __ATOMIC_ACQUIRE);
+  }
+  uint64_t read_sequence_number() const {
+    return __atomic_load_n(reinterpret_cast<const uint64_t*>(ring + descriptor->read_sequence_offset), __ATOMIC_RELAXED);
+  }
+  uint64_t version_number(unsigned version_idx) const {
+    return __atomic_load_n(reinterpret_cast<const uint64_t*>(ring + descriptor->versions_offset + (uint64_t)version_idx * descriptor->version_stride), __ATOMIC_ACQUIRE);
+  }
+  bool held(uint64_t version) const { return descriptor->implementation == RING_BUF_SPSC ? (version & 1) : (uint32_t)version != 0; }
+
+  // the full sequence number nearest to near whose low bits are in the slot's stamp
+  uint64_t stamp(const char* slot, uint64_t near) const {
+    const char* stamp = slot + descriptor->stamp_offset;
+    switch (descriptor->stamp_size) {
+      case 2: { uint16_t s; std::memcpy(&s, stamp, 2); return near + (int64_t)(int16_t)(uint16_t)(s - (uint16_t)near); }
+      case 4: { uint32_t s; std::memcpy(&s, stamp, 4); return near + (int64_t)(int32_t)(uint32_t)(s - (uint32_t)near); }
+      default: { uint64_t s; std::memcpy(&s, stamp, 8); return s; }
+    }
+  }
+
+  /* Copies seq's slot into copy (slot_stride bytes) and returns the sequence number found in it;
+  *torn is set if the region stayed held or changed during a few attempts.
+  */
+  uint64_t copy_slot(uint64_t seq, char* copy, bool* torn) const {
+    const unsigned version_idx = (seq - 1) & (descriptor->version_granularity - 1);
+    const char* slot = ring + descriptor->slots_offset + ((seq - 1) & (descriptor->length - 1)) * (uint64_t)descriptor->slot_stride;
+    for (unsigned attempt = 0; attempt < 100; ++attempt) {
+      const uint64_t version_before = version_number(version_idx);
+      std::memcpy(copy, slot, descriptor->slot_stride);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (!held(version_before) && version_number(version_idx) == version_before) {
+        *torn = false;
+        return stamp(copy, seq);
+      }
+    }
+    *torn = true;
+    return stamp(copy, seq);
+  }
+};
+
+static void dump_entries(const InspectedRing& inspected, uint64_t newest, unsigned count, ring_inspect_decode_fn decode) {
+  const RingBufDescriptor* descriptor = inspected.descriptor;
+  std::vector<char> slot(descriptor->slot_stride);
+  std::vector<char> line(4096);
+  const uint64_t oldest = newest > count ? newest - count + 1 : 1;
+  for (uint64_t seq = oldest; seq <= newest; ++seq) {
+    bool torn;
+    const uint64_t found = inspected.copy_slot(seq, slot.data(), &torn);
+    std::printf("  %" PRIu64 "%s", seq, torn ? " torn" : "");
+    if (found != seq) {
+      std::printf(" %s (slot holds %" PRIu64 ")\n", found < seq ? "not written" : "overwritten", found);
+      continue;
+    }
+    const char* data = slot.data() + descriptor->data_offset;
+    if (decode && decode(descriptor, seq, data, line.data(), line.size()) >= 0) {
+      std::printf(" %s\n", line.data());
+      continue;
+    }
+    std::printf(" ");
+    for (unsigned i = 0; i < descriptor->data_size; ++i) { std::printf("%02x", (unsigned char)data[i]); }
+    std::printf("\n");
+  }
+}
+
+int main(int argc, char** argv) {
+  unsigned interval_ms = 1000, dump_count = 0;
+  long samples = -1; // forever
+  const char* decoder_path = nullptr;
+  int option;
+  while ((option = getopt(argc, argv, "i:n:d:c:")) != -1) {
+    switch (option) {
+      case 'i': interval_ms = std::strtoul(optarg, nullptr, 0); break;
+      case 'n': dump_count = std::strtoul(optarg, nullptr, 0); break;
+      case 'd': decoder_path = optarg; break;
+      case 'c': samples = std::strtol(optarg, nullptr, 0); break;
+      default: return 2;
+    }
+  }
+  if (optind + 1 != argc || !interval_ms) {
+    std::fprintf(stderr, "usage: %s [-i interval ms] [-n entries to dump] [-d decoder.so] [-c samples] <path>\n", argv[0]);
+    return 2;
+  }
+
+  const int fd = open(argv[optind], O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st)) {
+    std::perror(argv[optind]);
+    return 1;
+  }
+  const void* mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  if ((size_t)st.st_size < sizeof(RingBufDescriptor) || mapping == MAP_FAILED) {
+    std::fprintf(stderr, "%s: cannot map a ring descriptor\n", argv[optind]);
+    return 1;
+  }
+  const RingBufDescriptor* descriptor = static_cast<const RingBufDescriptor*>(mapping);
+  if (__atomic_load_n(&descriptor->magic, __ATOMIC_ACQUIRE) != ring_buf_descriptor_magic
+    || descriptor->descriptor_version != ring_buf_descriptor_version
+    || descriptor->ring_offset + descriptor->ring_size > (uint64_t)st.st_size) {
+    std::fprintf(stderr, "%s: no ring descriptor of version %u\n", argv[optind], ring_buf_descriptor_version);
+    return 1;
+  }
+  const InspectedRing inspected{descriptor, static_cast<const char*>(mapping) + descriptor->ring_offset};
+
+  ring_inspect_decode_fn decode = nullptr;
+  if (decoder_path) {
+    void* decoder = dlopen(decoder_path, RTLD_NOW | RTLD_LOCAL);
+    decode = decoder ? reinterpret_cast<ring_inspect_decode_fn>(dlsym(decoder, "ring_inspect_decode")) : nullptr;
+    if (!decode) {
+      std::fprintf(stderr, "%s: %s\n", decoder_path, dlerror());
+      return 1;
+    }
+  }
+
+  static const char* const implementations[] = {"?", "spsc", "mpsc", "robust mpsc"};
+  std::printf("%s: %s, length %u, %u regions, %u-byte entries (%s), %u-byte slots, flags 0x%x\n", argv[optind],
+    implementations[descriptor->implementation <= RING_BUF_ROBUST_MPSC ? descriptor->implementation : 0],
+    descriptor->length, descriptor->version_granularity, descriptor->data_size, descriptor->data_type,
+    descriptor->slot_stride, descriptor->flags);
+
+  std::vector<uint64_t> previous_versions(descriptor->version_granularity);
+  for (unsigned version_idx = 0; version_idx < descriptor->version_granularity; ++version_idx) {
+    previous_versions[version_idx] = inspected.version_number(version_idx);
+  }
+  uint64_t previous_write = inspected.write_sequence_number(), previous_read = inspected.read_sequence_number();
+  auto previous_time = std::chrono::steady_clock::now();
+  for (long sample = 0; samples < 0 || sample < samples; ++sample) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
+    const uint64_t write = inspected.write_sequence_number(), read = inspected.read_sequence_number();
+    const auto now = std::chrono::steady_clock::now();
+    const double seconds = std::chrono::duration<double>(now - previous_time).count();
+
+    unsigned held_regions = 0;
+    long stuck_region = -1;
+    for (unsigned version_idx = 0; version_idx < descriptor->version_granularity; ++version_idx) {
+      const uint64_t version = inspected.version_number(version_idx);
+      if (inspected.held(version)) {
+        ++held_regions;
+        if (version == previous_versions[version_idx] && stuck_region < 0) { stuck_region = version_idx; }
+      }
+      previous_versions[version_idx] = version;
+    }
+    const uint64_t lag = write > read ? write - read : 0;
+    const char* verdict = read != previous_read ? "active" : lag ? "stalled" : "idle";
+    std::printf("write %" PRIu64 " read %" PRIu64 " lag %" PRIu64 " write/s %.0f read/s %.0f held %u/%u %s", write, read, lag,
+      (write - previous_write) / seconds, (read - previous_read) / seconds, held_regions, descriptor->version_granularity, verdict);
+    if (stuck_region >= 0) { std::printf(" stuck region %ld (0x%" PRIx64 ")", stuck_region, previous_versions[stuck_region]); }
+    std::printf("\n");
+    if (dump_count) { dump_entries(inspected, write, dump_count, decode); }
+    std::fflush(stdout);
+
+    previous_write = write;
+    previous_read = read;
+    previous_time = now;
+  }
+  return 0;
+}
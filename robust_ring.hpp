@@ -0,0 +1,303 @@
+#pragma once
+#include "ring_buf.hpp"
+#include "ring_descriptor.hpp"
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <new>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+
+/* Multi-process MPSC ring that survives producers dying at any instruction. With plain mpsc.cpp,
+a producer that dies between claiming a region and releasing it leaves its version number
+refcount above 0 forever and the reader spins on it; here no process can wedge the consumer.
+
+Producers attach() to get a lease: an index into a table of (pid, claimed sequence number) that
+lives next to the ring. A lease's index is also its bit in the low 32 bits of every version
+number, so the version number records which producers hold a region instead of how many do (the
+upper 32 bits still count completed writes, see RingBuf::version_numbers). The writer sets its
+bit, claims a sequence number, records it in the lease, copies the slot and then clears the bit
+and counts the write with one fetch_add, i.e., the same atomic operations as mpsc.cpp and no lock.
+
+When the reader has spun on a region for reap_interval iterations, it checks whether the holders'
+processes are alive (with a pidfd, or kill(pid, 0) on older kernels, so all processes must share a
+pid namespace). A dead holder is reaped: the slot it had claimed, possibly torn, is invalidated and
+its bit is cleared. A claimed
+entry whose region is free but that was never written can only belong to a dead producer, so read()
+skips it and counts it in abandoned_entries. Reaping may drop an entry that was complete but not
+released yet. A pid that is reused before the reaper looks keeps its dead predecessor's lease
+alive, which delays, but does not prevent, reaping once the new process exits.
+
+Place a RobustRing in shared memory (see SharedRobustRing) and include mpsc.cpp.
+*/
+template<typename DataType, unsigned length, unsigned version_granularity = length, unsigned flags = 0>
+struct RobustRing {
+  using Ring = RingBuf<DataType, length, version_granularity, flags>;
+  using stamp_t = typename Ring::stamp_t;
+  static_assert(std::is_trivially_copyable_v<DataType>, "DataType must be POD (to support memcpy)");
+
+  static constexpr unsigned max_producers = 32; // one bit each in the low half of a version number
+  static constexpr uint64_t reap_interval = 1 << 12; // reader spins on a held region between liveness checks
+
+  struct alignas(ALIGN_NO_FALSE_SHARING) __lease {
+    /* 0: free, > 0: pid of the producer holding the lease, < 0: minus the pid of a process that is
+    reaping the lease (a reaper that dies is itself reaped by the next one)
+    */
+    std::atomic<int32_t> pid;
+    std::atomic<uint64_t> claimed_sequence_number; // nonzero from the claim until the release
+  };
+
+  Ring ring;
+  __lease leases[max_producers];
+  std::atomic<uint64_t> reaped_producers;
+  uint64_t abandoned_entries; // consumer only
+
+  // A pidfd reports an exited process that is not waited for yet (a zombie), which kill(pid, 0) does not.
+  static bool process_alive(int32_t pid) {
+#ifdef SYS_pidfd_open
+    const int pidfd = syscall(SYS_pidfd_open, pid, 0);
+    if (pidfd >= 0) {
+      pollfd exited{pidfd, POLLIN, 0};
+      const int ready = poll(&exited, 1, 0);
+      ::close(pidfd);
+      return ready == 0;
+    }
+    if (errno == ESRCH) { return false; }
+#endif
+    return kill(pid, 0) == 0 || errno != ESRCH;
+  }
+
+  // Returns the producer index to pass to write(), or -1 if all leases are held by live processes.
+  int attach() {
+    const int32_t self = getpid();
+    for (unsigned producer = 0; producer < max_producers; ++producer) {
+      int32_t pid = leases[producer].pid.load(std::memory_order_acquire);
+      if (pid && !process_alive(pid < 0 ? -pid : pid)) {
+        reap(producer, pid);
+        pid = leases[producer].pid.load(std::memory_order_acquire);
+      }
+      if (!pid && leases[producer].pid.compare_exchange_strong(pid, self, std::memory_order_acq_rel)) { return producer; }
+    }
+    return -1;
+  }
+
+  // Gives the lease back; the producer must not be in the middle of a write.
+  void detach(unsigned producer) { leases[producer].pid.store(0, std::memory_order_release); }
+
+  // mpsc.cpp's write(), holding the region with the producer's bit instead of the refcount, see RingBuf::claim()
+  void write(unsigned producer, DataType* data) {
+    const uint64_t bit = uint64_t(1) << producer;
+    __lease& lease = leases[producer];
+    // the producer's bit is only ever set by itself, so adding and subtracting it sets and clears it
+    const typename Ring::Claim claimed = ring.claim(bit, std::memory_order_release); // a reader that sees the claim also sees the bit, see skip_abandoned()
+    volatile uint64_t write_guard = claimed.version_before_hold;
+
+    lease.claimed_sequence_number.store(claimed.sequence_number, std::memory_order_relaxed);
+    std::atomic_signal_fence(std::memory_order_seq_cst); // a reaper only runs once this process is gone, so program order is all it needs
+    typename Ring::versioned_DataType entry; // see spsc.cpp's write()
+    entry.data = *data;
+    entry.sequence_number = (stamp_t)claimed.sequence_number;
+    ring.stamp_write_time(entry, claimed.sequence_number);
+    if (write_guard != UINT64_MAX) { std::memcpy(&ring.buf[(claimed.sequence_number - 1) & (length - 1)], &entry, sizeof(entry)); } // always true, the branch only carries the dependency
+    ring.publish_dense_stamp(claimed.sequence_number);
+
+    claimed.version_number->fetch_add((uint64_t(1) << 32) - bit, std::memory_order_release); // clear the bit and count the completed write
+    lease.claimed_sequence_number.store(0, std::memory_order_relaxed);
+    RING_BUF_PROBE2(write_commit, &ring, claimed.sequence_number);
+  }
+
+  bool read(DataType* ret_data) {
+    for (;;) {
+      const uint64_t read_sequence_number = ring.read_sequence_number;
+      std::atomic<uint64_t>& version_number = ring.version_numbers[read_sequence_number & (version_granularity - 1)].number;
+      typename Ring::versioned_DataType entry;
+      uint64_t write_tsc; // dead without RING_BUF_LATENCY
+      uint64_t spins = 0;
+      for (;;) { // RingBuf::read()'s loop, except that it does not copy while the region is held
+        const uint64_t version_before = version_number.load(std::memory_order_acquire);
+        if ((uint32_t)version_before) {
+          if (!(++spins & (reap_interval - 1))) { reap_dead_holders((uint32_t)version_before); }
+          continue;
+        }
+        std::memcpy(&entry, &ring.buf[read_sequence_number & (length - 1)], sizeof(entry));
+        write_tsc = ring.write_time(entry, read_sequence_number + 1);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (version_number.load(std::memory_order_relaxed) == version_before) { break; }
+      }
+
+      if (Ring::stamp_after(entry.sequence_number, read_sequence_number)) {
+        std::memcpy(ret_data, &entry.data, sizeof(DataType));
+        ring.record_latency(write_tsc);
+        ring.read_sequence_number = read_sequence_number + 1;
+        RING_BUF_PROBE2(read_success, &ring, read_sequence_number + 1);
+        return true;
+      }
+      if (!skip_abandoned(version_number)) {
+        RING_BUF_PROBE2(read_empty, &ring, read_sequence_number + 1);
+        return false;
+      }
+    }
+  }
+
+  /* The next entry was not written. Returns whether the reader should look again, either because
+  the entry turned out to be abandoned and was skipped or because it was committed in the meantime.
+  */
+  bool skip_abandoned(std::atomic<uint64_t>& version_number) {
+    const uint64_t read_sequence_number = ring.read_sequence_number;
+    if (read_sequence_number >= ring.prod_u.atomic_global_write_sequence_number.load(std::memory_order_acquire)) { return false; } // not claimed
+    if ((uint32_t)version_number.load(std::memory_order_acquire)) { return false; } // the claimer may still be writing
+    const stamp_t stamp = __atomic_load_n(&ring.buf[read_sequence_number & (length - 1)].sequence_number, __ATOMIC_RELAXED);
+    if (!Ring::stamp_after(stamp, read_sequence_number)) {
+      ring.read_sequence_number = read_sequence_number + 1;
+      ++abandoned_entries;
+    }
+    return true;
+  }
+
+  void reap_dead_holders(uint32_t holders) {
+    for (; holders; holders &= holders - 1) {
+      const unsigned producer = __builtin_ctz(holders);
+      const int32_t pid = leases[producer].pid.load(std::memory_order_acquire);
+      if (pid && !process_alive(pid < 0 ? -pid : pid)) { reap(producer, pid); }
+    }
+  }
+
+  /* Releases everything the dead owner of lease producer held. dead_pid is the lease's pid as
+  observed; if another process got to the lease first, nothing is done. Every step is idempotent,
+  so a reaper that dies halfway through leaves a lease the next one can finish.
+  */
+  void reap(unsigned producer, int32_t dead_pid) {
+    __lease& lease = leases[producer];
+    if (!lease.pid.compare_exchange_strong(dead_pid, -(int32_t)getpid(), std::memory_order_acq_rel)) { return; }
+    const uint64_t bit = uint64_t(1) << producer;
+    const uint64_t claimed = lease.claimed_sequence_number.load(std::memory_order_relaxed);
+    for (unsigned version_idx = 0; version_idx < version_granularity; ++version_idx) {
+      std::atomic<uint64_t>& version_number = ring.version_numbers[version_idx].number;
+      if (!(version_number.load(std::memory_order_relaxed) & bit)) { continue; }
+      if (claimed && (claimed - 1) % version_granularity == version_idx) { // only touch the slot while its region is still held
+        __atomic_store_n(&ring.buf[(claimed - 1) & (length - 1)].sequence_number,
+          (stamp_t)(claimed > length ? claimed - length : 0), __ATOMIC_RELAXED); // a lap earlier reads as unwritten
+      }
+      version_number.fetch_add((uint64_t(1) << 32) - bit, std::memory_order_release);
+    }
+    lease.claimed_sequence_number.store(0, std::memory_order_relaxed);
+    reaped_producers.fetch_add(1, std::memory_order_relaxed);
+    lease.pid.store(0, std::memory_order_release);
+  }
+
+  RobustRing() : reaped_producers(0), abandoned_entries(0) {
+    for (__lease& lease : leases) {
+      lease.pid.store(0, std::memory_order_relaxed);
+      lease.claimed_sequence_number.store(0, std::memory_order_relaxed);
+    }
+  }
+};
+
+/* POSIX shared memory object holding a RobustRing. The process that creates the object (O_EXCL)
+constructs the ring and its RingBufDescriptor; the others wait until it is published. open()
+returns false with errno set if the object cannot be opened or mapped, holds another shape (EINVAL,
+including another DataType, flags or stamp width, see describes_ring()), or is never initialized.
+*/
+template<typename DataType, unsigned length, unsigned version_granularity = length, unsigned flags = 0>
+struct SharedRobustRing {
+  using Robust = RobustRing<DataType, length, version_granularity, flags>;
+  static_assert(alignof(Robust) <= 4096, "the ring must be placeable at a page-aligned mapping");
+
+  static constexpr uint64_t shared_magic = 0x5453424f52465542; // "BUFROBST"
+
+  struct alignas(ALIGN_NO_FALSE_SHARING) __shared_header {
+    RingBufDescriptor descriptor; // for ring_inspect
+    std::atomic<uint64_t> magic; // stored last by the creator
+    uint64_t ring_size;
+    uint64_t data_size;
+    uint32_t ring_length;
+    uint32_t ring_version_granularity;
+  };
+  static constexpr size_t ring_offset = (sizeof(__shared_header) + alignof(Robust) - 1) / alignof(Robust) * alignof(Robust);
+  static constexpr size_t mapping_size = ring_offset + sizeof(Robust);
+
+  int fd;
+  void* mapping;
+  __shared_header* header;
+  Robust* ring;
+
+  bool open(const char* name) {
+    bool creator = true;
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0 && errno == EEXIST) {
+      creator = false;
+      fd = shm_open(name, O_RDWR, 0600);
+    }
+    if (fd < 0) { return false; }
+    if (creator && ftruncate(fd, mapping_size)) { return fail(); }
+
+    struct stat st;
+    for (unsigned waited_ms = 0; ; ++waited_ms) { // the creator may not have sized or published the object yet
+      if (fstat(fd, &st)) { return fail(); }
+      if (st.st_size >= (off_t)mapping_size) { break; }
+      if (waited_ms == 1000) {
+        errno = st.st_size ? EINVAL : EAGAIN;
+        return fail();
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    mapping = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+      mapping = nullptr;
+      return fail();
+    }
+    header = static_cast<__shared_header*>(mapping);
+
+    if (creator) {
+      header->ring_size = sizeof(Robust);
+      header->data_size = sizeof(DataType);
+      header->ring_length = length;
+      header->ring_version_granularity = version_granularity;
+      ring = new (static_cast<char*>(mapping) + ring_offset) Robust();
+      describe_ring(&header->descriptor, &ring->ring, mapping, RING_BUF_ROBUST_MPSC);
+      header->magic.store(shared_magic, std::memory_order_release);
+      return true;
+    }
+    for (unsigned waited_ms = 0; header->magic.load(std::memory_order_acquire) != shared_magic; ++waited_ms) {
+      if (waited_ms == 1000) {
+        errno = EAGAIN;
+        return fail();
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ring = std::launder(reinterpret_cast<Robust*>(static_cast<char*>(mapping) + ring_offset));
+    if (header->ring_size != sizeof(Robust) || header->data_size != sizeof(DataType)
+      || header->ring_length != length || header->ring_version_granularity != version_granularity
+      || !describes_ring(&header->descriptor, &ring->ring, RING_BUF_ROBUST_MPSC)) {
+      errno = EINVAL;
+      return fail();
+    }
+    return true;
+  }
+
+  void close() {
+    if (mapping) { munmap(mapping, mapping_size); }
+    if (fd >= 0) { ::close(fd); }
+    mapping = nullptr;
+    fd = -1;
+  }
+
+  // removes the name; processes that have the object open keep using it
+  static bool unlink(const char* name) { return !shm_unlink(name); }
+
+  SharedRobustRing() : fd(-1), mapping(nullptr), header(nullptr), ring(nullptr) {}
+  ~SharedRobustRing() { close(); }
+  SharedRobustRing(const SharedRobustRing&) = delete;
+  SharedRobustRing& operator=(const SharedRobustRing&) = delete;
+
+  bool fail() {
+    const int saved_errno = errno;
+    close();
+    errno = saved_errno;
+    return false;
+  }
+};
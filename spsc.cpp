@@ -1,54 +1,223 @@
 #include "ring_buf.hpp"
 
-template<typename DataType, unsigned length, unsigned version_granularity>
-RingBuf<DataType, length, version_granularity>::RingBuf() {
+template<typename DataType, unsigned length, unsigned version_granularity, unsigned flags>
+const RingBufImplementation RingBuf<DataType, length, version_granularity, flags>::implementation = RING_BUF_SPSC;
+
+template<typename DataType, unsigned length, unsigned version_granularity, unsigned flags>
+RingBuf<DataType, length, version_granularity, flags>::RingBuf() {
   prod_u.write_sequence_number = 0;
   read_sequence_number = 0;
   for (unsigned i = 0; i < version_granularity; ++i) {
     version_numbers[i].number.store(0, std::memory_order_relaxed);
   }
-  versioned_DataType start{ .sequence_number = 0 };
+  versioned_DataType start{}; // sequence number 0: unwritten
   std::fill(buf, buf + length, start);
 }
 
-template<typename DataType, unsigned length, unsigned version_granularity>
-void RingBuf<DataType, length, version_granularity>::write(DataType* data) {
-  const unsigned version_idx = prod_u.write_sequence_number & (version_granularity - 1);
+template<typename DataType, unsigned length, unsigned version_granularity, unsigned flags>
+void RingBuf<DataType, length, version_granularity, flags>::write(DataType* data) {
+  static_assert(std::is_trivially_copyable_v<DataType>, "DataType must be POD (to support memcpy), otherwise use reserve()/commit() or emplace()");
+  const uint64_t write_sequence_number = prod_u.write_sequence_number;
+  const unsigned version_idx = write_sequence_number & (version_granularity - 1);
   std::atomic<uint64_t>& version_number = version_numbers[version_idx].number;
 
 
   /* Need release semantics for the second version number store to synchronize memcpy with it.
   Need an explicit dependency of the memcpy on the first version number store to synchronize it 
   with the latter; otherwise, the latter can be done with relaxed semantics.
+  The write sequence number is advanced before the region is claimed, so that an odd region always 
+  means the slot of the current write sequence number is the torn one, see recover().
   */
 
+  const uint64_t sequence_number = ++prod_u.write_sequence_number; // first written sequence number is 1
+  std::atomic_signal_fence(std::memory_order_seq_cst); // program order is all recover() needs
   volatile uint64_t write_guard = version_number.fetch_add(1, std::memory_order_relaxed);
 
 
-  const uint64_t write_sequence_number = prod_u.write_sequence_number;
-  versioned_DataType entry{*data, ++prod_u.write_sequence_number}; // first written sequence number is 1
-  if (write_guard) { std::memcpy(&buf[write_sequence_number & (length - 1)], &entry, sizeof(versioned_DataType)); }
+  versioned_DataType entry; // write_tsc, if any, is set by stamp_write_time()
+  entry.data = *data;
+  entry.sequence_number = (stamp_t)sequence_number;
+  RING_BUF_PROBE2(write_claim, this, sequence_number);
+  this->stamp_write_time(entry, sequence_number);
+  if (write_guard != UINT64_MAX) { std::memcpy(&buf[write_sequence_number & (length - 1)], &entry, sizeof(versioned_DataType)); } // always true, the branch only carries the dependency
+  this->publish_dense_stamp(sequence_number);
   
   version_number.fetch_add(1, std::memory_order_release);
+  RING_BUF_PROBE2(write_commit, this, sequence_number);
 }
 
-template<typename DataType, unsigned length, unsigned version_granularity>
-bool RingBuf<DataType, length, version_granularity>::read(DataType* ret_data) {
+template<typename DataType, unsigned length, unsigned version_granularity, unsigned flags>
+bool RingBuf<DataType, length, version_granularity, flags>::read(DataType* ret_data) {
+  static_assert(std::is_trivially_copyable_v<DataType>, "DataType must be POD (to support memcpy), otherwise use consume() or take()");
   const unsigned version_idx = read_sequence_number & (version_granularity - 1);
   std::atomic<uint64_t>& version_number = version_numbers[version_idx].number;
 
   versioned_DataType entry;
+  uint64_t write_tsc; // dead without RING_BUF_LATENCY
   /* need full load fence to synchronize check with the memcpy (do first then check); this is not equivalent to, and hence more efficient than, 
   sequential consistency because stores that happen after the fence can still be committed out of order regardless of the fence since the version 
-  number load has relaxed semantics
+  number load has relaxed semantics. The version number is also loaded (with acquire semantics, to see the data of completed writes) before the 
+  memcpy, since a write that starts and finishes during the memcpy leaves the final check alone unchanged.
   */
+  uint64_t attempts = 0; // dead unless RING_BUF_COUNTERS or the SDT probes are enabled
+  uint64_t version_before;
   do {
+    ++attempts;
+    version_before = version_number.load(std::memory_order_acquire);
     std::memcpy(&entry, &buf[read_sequence_number & (length - 1)], sizeof(versioned_DataType));
+    write_tsc = this->write_time(entry, read_sequence_number + 1);
     std::atomic_thread_fence(std::memory_order_acquire);
-  } while (version_number.load(std::memory_order_relaxed) & 1);
+  } while ((version_before & 1) || version_number.load(std::memory_order_relaxed) != version_before);
+  this->count_torn_read_retries(attempts - 1);
+  if (attempts > 1) { RING_BUF_PROBE3(read_retry, this, read_sequence_number + 1, attempts - 1); }
 
-  unsigned char success = (uint64_t)(read_sequence_number - entry.sequence_number) >> 63; // success iff sequence number > read sequence number
-  if (success) { std::memcpy(ret_data, &entry.data, sizeof(DataType)); } // conditional since DataType may be large, e.g., a whole network packet
+  unsigned char success = stamp_after(entry.sequence_number, read_sequence_number); // success iff sequence number > read sequence number
+  if (success) {
+    std::memcpy(ret_data, &entry.data, sizeof(DataType)); // conditional since DataType may be large, e.g., a whole network packet
+    this->record_latency(write_tsc);
+    RING_BUF_PROBE2(read_success, this, read_sequence_number + 1);
+  } else {
+    this->count_failed_read();
+    RING_BUF_PROBE2(read_empty, this, read_sequence_number + 1);
+  }
   read_sequence_number += success;
   return success;
-}
\ No newline at end of file
+}
+
+template<typename DataType, unsigned length, unsigned version_granularity, unsigned flags>
+uint64_t RingBuf<DataType, length, version_granularity, flags>::peek(uint64_t seq, DataType* ret_data, uint64_t* ret_write_tsc) {
+  static_assert(std::is_trivially_copyable_v<DataType>, "DataType must be POD (to support memcpy), otherwise use consume() or take()");
+  const unsigned version_idx = (seq - 1) & (version_granularity - 1);
+  std::atomic<uint64_t>& version_number = version_numbers[version_idx].number;
+
+  versioned_DataType entry;
+  uint64_t write_tsc; // 0 without RING_BUF_LATENCY
+  uint64_t version_before; // see read()
+  do {
+    version_before = version_number.load(std::memory_order_acquire);
+    std::memcpy(&entry, &buf[(seq - 1) & (length - 1)], sizeof(versioned_DataType));
+    write_tsc = this->write_time(entry, seq);
+    std::atomic_thread_fence(std::memory_order_acquire);
+  } while ((version_before & 1) || version_number.load(std::memory_order_relaxed) != version_before);
+
+  if (entry.sequence_number == (stamp_t)seq) {
+    std::memcpy(ret_data, &entry.data, sizeof(DataType));
+    if (ret_write_tsc) { *ret_write_tsc = write_tsc; }
+  }
+  return expand_stamp(entry.sequence_number, seq);
+}
+
+template<typename DataType, unsigned length, unsigned version_granularity, unsigned flags>
+uint64_t RingBuf<DataType, length, version_granularity, flags>::peek_sequence_number(uint64_t seq) {
+  std::atomic<uint64_t>& version_number = version_numbers[(seq - 1) & (version_granularity - 1)].number;
+  const versioned_DataType& slot = buf[(seq - 1) & (length - 1)];
+
+  uint64_t version_before;
+  stamp_t stamp;
+  do { // see consume()
+    version_before = version_number.load(std::memory_order_acquire);
+    stamp = __atomic_load_n(&slot.sequence_number, __ATOMIC_RELAXED);
+    std::atomic_thread_fence(std::memory_order_acquire);
+  } while ((version_before & 1) || version_number.load(std::memory_order_relaxed) != version_before);
+  return expand_stamp(stamp, seq);
+}
+
+template<typename DataType, unsigned length, unsigned version_granularity, unsigned flags>
+uint64_t RingBuf<DataType, length, version_granularity, flags>::recover() {
+  auto full = [this](stamp_t stamp) { return expand_stamp(stamp, read_sequence_number); }; // every stamp is within length of the reader
+  const uint64_t torn_sequence_number = prod_u.write_sequence_number; // advanced before its region is claimed, see write()
+  for (unsigned version_idx = 0; version_idx < version_granularity; ++version_idx) {
+    std::atomic<uint64_t>& version_number = version_numbers[version_idx].number;
+    // odd: the writer died mid-write (at most one, it is SPSC), and only its slot may be torn
+    if ((version_number.load(std::memory_order_relaxed) & 1) && torn_sequence_number && ((torn_sequence_number - 1) & (version_granularity - 1)) == version_idx) {
+      buf[(torn_sequence_number - 1) & (length - 1)].sequence_number = (stamp_t)(torn_sequence_number > length ? torn_sequence_number - length : 0); // a lap earlier reads as unwritten
+    }
+    version_number.store(0, std::memory_order_relaxed);
+  }
+
+  uint64_t newest_sequence_number = read_sequence_number; // never hand out a sequence number the reader already passed
+  for (const versioned_DataType& entry : buf) { newest_sequence_number = std::max(newest_sequence_number, full(entry.sequence_number)); }
+  prod_u.write_sequence_number = newest_sequence_number;
+  this->rebuild_dense_stamps(buf, full);
+  std::atomic_thread_fence(std::memory_order_release);
+  return newest_sequence_number;
+}
+
+template<typename DataType, unsigned length, unsigned version_granularity, unsigned flags>
+typename RingBuf<DataType, length, version_granularity, flags>::Reservation RingBuf<DataType, length, version_granularity, flags>::reserve() {
+  const uint64_t write_sequence_number = prod_u.write_sequence_number++; // before the claim, see write()
+  const unsigned version_idx = write_sequence_number & (version_granularity - 1);
+  std::atomic<uint64_t>& version_number = version_numbers[version_idx].number;
+  std::atomic_signal_fence(std::memory_order_seq_cst);
+  version_number.fetch_add(1, std::memory_order_relaxed); // odd, see write()
+  std::atomic_thread_fence(std::memory_order_release); // the claim is visible before anything constructed in the slot
+  RING_BUF_PROBE2(write_claim, this, write_sequence_number + 1);
+  return Reservation{ reinterpret_cast<DataType*>(&buf[write_sequence_number & (length - 1)].data), write_sequence_number + 1, &version_number };
+}
+
+template<typename DataType, unsigned length, unsigned version_granularity, unsigned flags>
+void RingBuf<DataType, length, version_granularity, flags>::commit(const Reservation& reservation) {
+  versioned_DataType& slot = buf[(reservation.sequence_number - 1) & (length - 1)];
+  slot.sequence_number = (stamp_t)reservation.sequence_number;
+  this->stamp_write_time(slot, reservation.sequence_number);
+  this->publish_dense_stamp(reservation.sequence_number);
+  reservation.version_number->fetch_add(1, std::memory_order_release);
+  RING_BUF_PROBE2(write_commit, this, reservation.sequence_number);
+}
+
+template<typename DataType, unsigned length, unsigned version_granularity, unsigned flags>
+template<typename F>
+bool RingBuf<DataType, length, version_granularity, flags>::consume(F&& on_entry) {
+  const unsigned version_idx = read_sequence_number & (version_granularity - 1);
+  std::atomic<uint64_t>& version_number = version_numbers[version_idx].number;
+  versioned_DataType& slot = buf[read_sequence_number & (length - 1)];
+
+  /* Unlike read(), the entry is not copied speculatively: only its sequence number is checked 
+  under the version number. Once that shows a committed entry, the slot belongs to the consumer 
+  until the writers come around again, which is not expected (see write()).
+  */
+  uint64_t attempts = 0; // dead unless RING_BUF_COUNTERS or the SDT probes are enabled
+  uint64_t version_before;
+  stamp_t sequence_number;
+  uint64_t write_tsc; // dead without RING_BUF_LATENCY
+  do {
+    ++attempts;
+    version_before = version_number.load(std::memory_order_acquire);
+    sequence_number = __atomic_load_n(&slot.sequence_number, __ATOMIC_RELAXED);
+    write_tsc = this->write_time(slot, read_sequence_number + 1);
+    std::atomic_thread_fence(std::memory_order_acquire);
+  } while ((version_before & 1) || version_number.load(std::memory_order_relaxed) != version_before);
+  this->count_torn_read_retries(attempts - 1);
+  if (attempts > 1) { RING_BUF_PROBE3(read_retry, this, read_sequence_number + 1, attempts - 1); }
+
+  if (!stamp_after(sequence_number, read_sequence_number)) { // same test as read()
+    this->count_failed_read();
+    RING_BUF_PROBE2(read_empty, this, read_sequence_number + 1);
+    return false;
+  }
+  DataType* entry = std::launder(reinterpret_cast<DataType*>(&slot.data));
+  this->record_latency(write_tsc);
+  on_entry(std::move(*entry));
+  entry->~DataType();
+  ++read_sequence_number;
+  RING_BUF_PROBE2(read_success, this, read_sequence_number);
+  return true;
+}
+
+template<typename DataType, unsigned length, unsigned version_granularity, unsigned flags>
+DataType* RingBuf<DataType, length, version_granularity, flags>::front(unsigned ahead) {
+  const uint64_t sequence_number = read_sequence_number + ahead; // of the entry before the wanted one
+  std::atomic<uint64_t>& version_number = version_numbers[sequence_number & (version_granularity - 1)].number;
+  versioned_DataType& slot = buf[sequence_number & (length - 1)];
+
+  uint64_t version_before;
+  stamp_t stamp;
+  do { // see consume()
+    version_before = version_number.load(std::memory_order_acquire);
+    stamp = __atomic_load_n(&slot.sequence_number, __ATOMIC_RELAXED);
+    std::atomic_thread_fence(std::memory_order_acquire);
+  } while ((version_before & 1) || version_number.load(std::memory_order_relaxed) != version_before);
+
+  if (!stamp_after(stamp, sequence_number)) { return nullptr; }
+  return std::launder(reinterpret_cast<DataType*>(&slot.data));
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdio>
+#include <cstdlib>
+
+/* Checks shared by the tests. Every test is a program of its own that includes spsc.cpp or
+mpsc.cpp itself (a test that runs against both picks one with -DRING_TEST_MPSC, like the
+benchmarks) and exits nonzero at the first failed check.
+*/
+#define TEST_CHECK(condition) \
+  do { \
+    if (!(condition)) { \
+      std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+      std::exit(1); \
+    } \
+  } while (0)
+
+#define TEST_CHECK_EQ(actual, expected) \
+  do { \
+    const unsigned long long __actual = (actual), __expected = (expected); \
+    if (__actual != __expected) { \
+      std::fprintf(stderr, "%s:%d: check failed: %s == %s (%llu != %llu)\n", __FILE__, __LINE__, #actual, #expected, __actual, __expected); \
+      std::exit(1); \
+    } \
+  } while (0)
+
+#ifdef RING_TEST_MPSC
+#define RING_TEST_IMPL "mpsc"
+#else
+#define RING_TEST_IMPL "spsc"
+#endif
@@ -0,0 +1,116 @@
+/* RingCapture and RingReplayer: a capture replayed into another ring delivers the same entries in
+the same order, with RING_BUF_LATENCY the records carry each entry's exact write time, entries
+that the writers overwrite before the tap sees them are counted as missed, and a replay at speed 1
+takes at least as long as the writes it reproduces.
+  g++ -std=c++17 -O2 -pthread test_capture_replay.cpp -o test_capture_replay
+*/
+#include "spsc.cpp"
+#include "capture_replay.hpp"
+#include "test.hpp"
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+struct Message {
+  uint64_t value;
+  uint32_t tag;
+};
+
+static constexpr unsigned ring_length = 64;
+
+template<unsigned flags>
+using Ring = RingBuf<Message, ring_length, 8, flags>;
+
+static std::string capture_path(const char* name) { return "/tmp/ring_buf_test_" + std::string(name) + "_" + std::to_string(getpid()) + ".cap"; }
+
+static std::vector<__capture_record<Message>> read_records(const std::string& path, CaptureFileHeader* header) {
+  std::vector<__capture_record<Message>> records;
+  FILE* file = std::fopen(path.c_str(), "rb");
+  TEST_CHECK(file);
+  TEST_CHECK_EQ(std::fread(header, sizeof(*header), 1, file), 1);
+  __capture_record<Message> record;
+  while (std::fread(&record, sizeof(record), 1, file) == 1) { records.push_back(record); }
+  std::fclose(file);
+  return records;
+}
+
+template<unsigned flags>
+static void check_round_trip(const char* name, unsigned count) {
+  std::unique_ptr<Ring<flags>> source(new Ring<flags>());
+  const std::string path = capture_path(name);
+  Message message{0, 7};
+  source->write(&message); // before the capture: not recorded
+  {
+    RingCapture<Message, ring_length, 8, flags> capture(source.get());
+    TEST_CHECK(capture.open(path.c_str()));
+    for (uint64_t value = 1; value <= count; ++value) {
+      message = Message{value, (uint32_t)(value * 3)};
+      source->write(&message);
+      TEST_CHECK_EQ(capture.poll(), 1);
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    TEST_CHECK(capture.close());
+  }
+
+  CaptureFileHeader header;
+  const std::vector<__capture_record<Message>> records = read_records(path, &header);
+  TEST_CHECK_EQ(header.magic, capture_magic);
+  TEST_CHECK_EQ(header.records, count);
+  TEST_CHECK_EQ(header.missed, 0);
+  TEST_CHECK_EQ(records.size(), count);
+  for (unsigned i = 0; i < records.size(); ++i) {
+    TEST_CHECK_EQ(records[i].sequence_number, i + 2);
+    if (i) { TEST_CHECK(records[i].tsc > records[i - 1].tsc); }
+    if constexpr ((flags & RING_BUF_LATENCY) != 0) {
+      const uint64_t seq = records[i].sequence_number;
+      TEST_CHECK_EQ(records[i].tsc, source->write_time(source->buf[(seq - 1) & (ring_length - 1)], seq));
+    }
+  }
+
+  // as fast as possible, then with the original timing
+  for (double speed : {0.0, 1.0}) {
+    std::unique_ptr<Ring<0>> target(new Ring<0>());
+    RingReplayer<Message> replayer;
+    TEST_CHECK(replayer.open(path.c_str()));
+    const auto start = std::chrono::steady_clock::now();
+    TEST_CHECK_EQ(replayer.replay(*target, speed), count);
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    if (speed > 0) { TEST_CHECK(elapsed >= std::chrono::milliseconds(count - 1) * 9 / 10); } // the writes were >= 1 ms apart
+    for (uint64_t value = 1; value <= count; ++value) {
+      TEST_CHECK(target->read(&message));
+      TEST_CHECK_EQ(message.value, value);
+      TEST_CHECK_EQ(message.tag, value * 3);
+    }
+    TEST_CHECK(!target->read(&message));
+  }
+  TEST_CHECK(!std::remove(path.c_str()));
+}
+
+static void check_missed() {
+  std::unique_ptr<Ring<RING_BUF_LATENCY>> source(new Ring<RING_BUF_LATENCY>());
+  const std::string path = capture_path("missed");
+  RingCapture<Message, ring_length, 8, RING_BUF_LATENCY> capture(source.get());
+  TEST_CHECK(capture.open(path.c_str()));
+  for (uint64_t value = 1; value <= 3 * ring_length; ++value) {
+    Message message{value, 0};
+    source->write(&message);
+  }
+  TEST_CHECK_EQ(capture.poll(), ring_length); // only the last lap is left
+  TEST_CHECK(capture.close());
+
+  CaptureFileHeader header;
+  const std::vector<__capture_record<Message>> records = read_records(path, &header);
+  TEST_CHECK_EQ(header.records, ring_length);
+  TEST_CHECK_EQ(header.missed, 2 * ring_length);
+  TEST_CHECK_EQ(records.front().sequence_number, 2 * ring_length + 1);
+  TEST_CHECK_EQ(records.front().data.value, 2 * ring_length + 1);
+  TEST_CHECK(!std::remove(path.c_str()));
+}
+
+int main() {
+  check_round_trip<0>("tap_time", 20);
+  check_round_trip<RING_BUF_LATENCY>("write_time", 20);
+  check_missed();
+  std::printf("test_capture_replay: ok\n");
+  return 0;
+}
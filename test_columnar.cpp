@@ -0,0 +1,128 @@
+/* ColumnarRing: records round-trip through the described fields only, a batch never runs past the
+end of the arrays, so one that wraps comes in two spans whose columns stay in step, partial
+consumes resume where they stopped, and entries the producer overwrote before or while they were
+read are skipped or reported and counted.
+  g++ -std=c++17 -O2 -pthread test_columnar.cpp -o test_columnar
+*/
+#include "columnar_ring.hpp"
+#include "test.hpp"
+#include <memory>
+#include <thread>
+
+struct Quote {
+  double price;
+  uint32_t quantity;
+  uint64_t instrument_id;
+  uint64_t not_stored;
+};
+
+using Ring = ColumnarRing<Quote, 8, &Quote::price, &Quote::quantity, &Quote::instrument_id>;
+
+static Quote quote(uint64_t i) { return Quote{i * 0.5, (uint32_t)(i * 3), i, i}; }
+
+static void write_quotes(Ring& ring, uint64_t first, uint64_t last) {
+  for (uint64_t i = first; i <= last; ++i) {
+    const Quote entry = quote(i);
+    ring.write(&entry);
+  }
+}
+
+// checks that a batch holds the entries with consecutive ids from first on, in every column
+static void check_batch(const Ring::Batch& batch, uint64_t first, unsigned count) {
+  TEST_CHECK_EQ(batch.count, count);
+  for (unsigned i = 0; i < batch.count; ++i) {
+    TEST_CHECK_EQ(batch.column<&Quote::instrument_id>()[i], first + i);
+    TEST_CHECK(batch.column<&Quote::price>()[i] == (first + i) * 0.5);
+    TEST_CHECK_EQ(batch.column<&Quote::quantity>()[i], (first + i) * 3);
+  }
+}
+
+static void check_read() {
+  std::unique_ptr<Ring> ring(new Ring());
+  Quote entry{};
+  TEST_CHECK(!ring->read(&entry));
+  for (uint64_t i = 1; i <= 20; ++i) { // several laps
+    write_quotes(*ring, i, i);
+    entry.not_stored = 7;
+    TEST_CHECK(ring->read(&entry));
+    TEST_CHECK_EQ(entry.instrument_id, i);
+    TEST_CHECK_EQ(entry.quantity, i * 3);
+    TEST_CHECK(entry.price == i * 0.5);
+    TEST_CHECK_EQ(entry.not_stored, 7); // not described, so left alone
+  }
+  TEST_CHECK(!ring->read(&entry));
+}
+
+static void check_batches_across_the_wrap() {
+  std::unique_ptr<Ring> ring(new Ring());
+  write_quotes(*ring, 0, 4);
+  check_batch(ring->read_batch(100), 0, 5);
+  ring->consume(5); // the reader is at index 5
+
+  write_quotes(*ring, 5, 10); // 5..7 at the end of the arrays, 8..10 wrapped to the start
+  Ring::Batch batch = ring->read_batch(100);
+  TEST_CHECK_EQ(batch.first_index, 5);
+  check_batch(batch, 5, 3); // stops at the end of the arrays
+  ring->consume(2); // partial: 7 is still unread
+  batch = ring->read_batch(100);
+  TEST_CHECK_EQ(batch.first_index, 7);
+  check_batch(batch, 7, 1);
+  ring->consume(1);
+  batch = ring->read_batch(2);
+  TEST_CHECK_EQ(batch.first_index, 0);
+  check_batch(batch, 8, 2); // limited by max_count
+  ring->consume(2);
+  check_batch(ring->read_batch(100), 10, 1);
+  ring->consume(1);
+  check_batch(ring->read_batch(100), 11, 0);
+}
+
+static void check_lapped() {
+  std::unique_ptr<Ring> ring(new Ring());
+  write_quotes(*ring, 0, 19); // with 20 published, entry 20 may be going over 12
+  Quote entry{};
+  TEST_CHECK(ring->read(&entry));
+  TEST_CHECK_EQ(entry.instrument_id, 13);
+  TEST_CHECK_EQ(ring->lost_entries, 13);
+
+  ring.reset(new Ring());
+  write_quotes(*ring, 0, 19);
+  check_batch(ring->read_batch(100), 13, 3); // skipped up to 13, then stops at the end of the arrays
+  TEST_CHECK_EQ(ring->consume(3), 0);
+  check_batch(ring->read_batch(100), 16, 4);
+  write_quotes(*ring, 20, 27); // laps the batch while it is in use
+  TEST_CHECK_EQ(ring->consume(4), 4);
+  TEST_CHECK_EQ(ring->lost_entries, 17);
+  check_batch(ring->read_batch(100), 21, 3); // 20 is gone too
+  TEST_CHECK_EQ(ring->lost_entries, 18);
+}
+
+static void check_concurrent_producer() {
+  std::unique_ptr<Ring> ring(new Ring());
+  const uint64_t total = 200000;
+  std::thread producer([&] {
+    for (uint64_t i = 0; i < total; ++i) {
+      while (i - __atomic_load_n(&ring->read_sequence_number, __ATOMIC_ACQUIRE) >= 4) { std::this_thread::yield(); }
+      const Quote entry = quote(i);
+      ring->write(&entry);
+    }
+  });
+  uint64_t next = 0;
+  while (next < total) {
+    const Ring::Batch batch = ring->read_batch(8);
+    check_batch(batch, next, batch.count);
+    next += batch.count;
+    __atomic_store_n(&ring->read_sequence_number, next, __ATOMIC_RELEASE);
+    if (!batch.count) { std::this_thread::yield(); }
+  }
+  producer.join();
+}
+
+int main() {
+  check_read();
+  check_batches_across_the_wrap();
+  check_lapped();
+  check_concurrent_producer();
+  std::printf("test_columnar: ok\n");
+  return 0;
+}
@@ -0,0 +1,94 @@
+/* CombiningRing: a producer publishes its line when it is full, or once the oldest pending message
+is older than max_delay_ticks (on write() or poll()), never by delay without max_delay_ticks, and
+on flush() or destruction; the consumer gets every message in order through read() and read_line().
+  g++ -std=c++17 -O2 -pthread test_combining.cpp -o test_combining
+  g++ -std=c++17 -O2 -pthread -DRING_TEST_MPSC test_combining.cpp -o test_combining_mpsc
+*/
+#ifdef RING_TEST_MPSC
+#include "mpsc.cpp"
+#else
+#include "spsc.cpp"
+#endif
+#include "combining_ring.hpp"
+#include "test.hpp"
+#include <memory>
+
+using Channel = CombiningRing<uint64_t, 16, 4>;
+static constexpr unsigned capacity = Channel::capacity;
+static_assert(capacity > 1, "several messages per line");
+static_assert(sizeof(Channel::Ring::versioned_DataType) <= 64, "a slot fits the line");
+
+// reads everything published and checks that it is first, first + 1, ...; returns how many were read
+static uint64_t drain(Channel& channel, uint64_t first) {
+  uint64_t message, count = 0;
+  while (channel.read(&message)) { TEST_CHECK_EQ(message, first + count++); }
+  return count;
+}
+
+static void check_flush_on_size() {
+  std::unique_ptr<Channel> channel(new Channel());
+  Channel::Producer producer(channel.get());
+  uint64_t next = 0;
+  for (unsigned i = 0; i < capacity - 1; ++i) { producer.write(next++); }
+  TEST_CHECK_EQ(drain(*channel, 0), 0); // still pending
+  TEST_CHECK(!producer.poll()); // no max_delay_ticks: never due
+  TEST_CHECK_EQ(drain(*channel, 0), 0);
+  producer.write(next++); // fills the line
+  TEST_CHECK_EQ(drain(*channel, 0), capacity);
+
+  for (unsigned i = 0; i < 2 * capacity + 1; ++i) { producer.write(next++); }
+  const uint64_t* messages = nullptr;
+  for (unsigned line = 0; line < 2; ++line) {
+    TEST_CHECK_EQ(channel->read_line(&messages), capacity);
+    for (unsigned i = 0; i < capacity; ++i) { TEST_CHECK_EQ(messages[i], capacity + line * capacity + i); }
+  }
+  TEST_CHECK_EQ(channel->read_line(&messages), 0);
+  producer.flush(); // the odd one out
+  TEST_CHECK_EQ(channel->read_line(&messages), 1);
+  TEST_CHECK_EQ(messages[0], 3 * capacity);
+  producer.flush(); // nothing pending, nothing published
+  TEST_CHECK_EQ(channel->read_line(&messages), 0);
+
+  uint64_t message;
+  producer.write(next++);
+  producer.write(next++);
+  producer.flush();
+  TEST_CHECK(channel->read(&message)); // read() and read_line() share the current line
+  TEST_CHECK_EQ(message, 3 * capacity + 1);
+  TEST_CHECK_EQ(channel->read_line(&messages), 1);
+  TEST_CHECK_EQ(messages[0], 3 * capacity + 2);
+}
+
+static void check_flush_on_delay() {
+  std::unique_ptr<Channel> channel(new Channel());
+  const uint64_t max_delay_ticks = uint64_t(1) << 50; // never reached by itself; the test ages messages instead
+  {
+    Channel::Producer producer(channel.get(), max_delay_ticks);
+    producer.write(0);
+    TEST_CHECK(!producer.poll()); // not due yet
+    TEST_CHECK_EQ(drain(*channel, 0), 0);
+    producer.first_pending_tsc = ring_buf_tsc() - max_delay_ticks; // the oldest message is now due
+    TEST_CHECK(producer.poll());
+    TEST_CHECK_EQ(drain(*channel, 0), 1);
+    TEST_CHECK(!producer.poll()); // nothing pending
+
+    producer.write(1);
+    producer.write(2);
+    TEST_CHECK_EQ(drain(*channel, 1), 0);
+    producer.first_pending_tsc -= max_delay_ticks;
+    producer.write(3); // finds the oldest pending message due and publishes the line with itself in it
+    TEST_CHECK_EQ(drain(*channel, 1), 3);
+
+    producer.write(4); // the delay counts from the first message of the new line
+    TEST_CHECK(!producer.poll());
+    TEST_CHECK_EQ(drain(*channel, 4), 0);
+  }
+  TEST_CHECK_EQ(drain(*channel, 4), 1); // the destructor flushes
+}
+
+int main() {
+  check_flush_on_size();
+  check_flush_on_delay();
+  std::printf("test_combining (" RING_TEST_IMPL "): ok\n");
+  return 0;
+}
@@ -0,0 +1,110 @@
+/* RING_BUF_STAMP16 and RING_BUF_STAMP32 across the point where the stamps wrap: read(), peek(),
+recover() and expand_stamp() stay exact for more than 2^16 writes, and for 2^32 with the ring
+started just below it (the slots stamped as if the earlier laps had been written).
+  g++ -std=c++17 -O2 -pthread test_compact_stamps.cpp -o test_compact_stamps
+  g++ -std=c++17 -O2 -pthread -DRING_TEST_MPSC test_compact_stamps.cpp -o test_compact_stamps_mpsc
+*/
+#ifdef RING_TEST_MPSC
+#include "mpsc.cpp"
+#else
+#include "spsc.cpp"
+#endif
+#include "test.hpp"
+#include <memory>
+
+struct Message {
+  uint64_t value;
+};
+
+static constexpr unsigned ring_length = 16;
+
+/* Moves an empty ring to sequence number start, as if start entries had been written and read:
+every slot holds the stamp of the last entry written to it.
+*/
+template<typename Ring>
+static void start_at(Ring& ring, uint64_t start) {
+  for (unsigned i = 0; i < ring_length; ++i) {
+    const uint64_t newest = start - ((start - 1 - i) & (ring_length - 1)); // as in recover()
+    ring.buf[i].sequence_number = (typename Ring::stamp_t)newest;
+  }
+  __atomic_store_n(&ring.prod_u.write_sequence_number, start, __ATOMIC_RELAXED); // the same 64 bits for SPSC and MPSC
+  ring.read_sequence_number = start;
+}
+
+template<typename Ring>
+static void check_expand_stamp(uint64_t wrap) {
+  using stamp_t = typename Ring::stamp_t;
+  for (uint64_t seq = wrap - 3 * ring_length; seq < wrap + 3 * ring_length; ++seq) {
+    for (uint64_t near : {seq - ring_length, seq, seq + ring_length}) {
+      TEST_CHECK_EQ(Ring::expand_stamp((stamp_t)seq, near), seq);
+    }
+    TEST_CHECK(Ring::stamp_after((stamp_t)(seq + 1), seq));
+    TEST_CHECK(!Ring::stamp_after((stamp_t)seq, seq));
+    TEST_CHECK(!Ring::stamp_after((stamp_t)(seq + 1 - ring_length), seq)); // a lap earlier
+  }
+}
+
+// writes from the ring's position to past wrap, reading each entry back and peeking around it
+template<typename Ring>
+static void check_across(Ring& ring, uint64_t wrap) {
+  Message message{};
+  const uint64_t start = ring.read_sequence_number;
+  TEST_CHECK(!ring.read(&message));
+  for (uint64_t seq = start + 1; seq <= wrap + 2 * ring_length; ++seq) {
+    message.value = seq;
+    ring.write(&message);
+
+    Message peeked{};
+    TEST_CHECK_EQ(ring.peek(seq, &peeked), seq);
+    TEST_CHECK_EQ(peeked.value, seq);
+    if (seq > ring_length) { TEST_CHECK_EQ(ring.peek(seq - ring_length, &peeked), seq); } // overwritten, by exactly seq
+    if (seq >= ring_length) { TEST_CHECK_EQ(ring.peek_sequence_number(seq + 1), seq + 1 - ring_length); } // not written yet: a lap earlier
+
+    TEST_CHECK(ring.read(&message));
+    TEST_CHECK_EQ(message.value, seq);
+    TEST_CHECK_EQ(ring.read_sequence_number, seq);
+    TEST_CHECK(!ring.read(&message));
+
+    if (seq == wrap - 1 || seq == wrap || seq == wrap + 1) {
+      TEST_CHECK_EQ(ring.recover(), seq); // finds the newest entry across the wrap
+      TEST_CHECK(!ring.read(&message));
+    }
+  }
+
+  // recover() with unread entries on both sides of the wrap
+  start_at(ring, wrap - ring_length / 2);
+  for (uint64_t seq = wrap - ring_length / 2 + 1; seq <= wrap + ring_length / 2; ++seq) {
+    message.value = seq;
+    ring.write(&message);
+  }
+  TEST_CHECK_EQ(ring.recover(), wrap + ring_length / 2);
+  for (uint64_t seq = wrap - ring_length / 2 + 1; seq <= wrap + ring_length / 2; ++seq) {
+    TEST_CHECK(ring.read(&message));
+    TEST_CHECK_EQ(message.value, seq);
+  }
+  TEST_CHECK(!ring.read(&message));
+}
+
+int main() {
+  using Ring16 = RingBuf<Message, ring_length, 4, RING_BUF_STAMP16>;
+  using Ring32 = RingBuf<Message, ring_length, 4, RING_BUF_STAMP32>;
+  static_assert(sizeof(Ring16::stamp_t) == 2 && sizeof(Ring32::stamp_t) == 4, "compact stamps");
+  const uint64_t wrap16 = uint64_t(1) << 16, wrap32 = uint64_t(1) << 32;
+
+  check_expand_stamp<Ring16>(wrap16);
+  check_expand_stamp<Ring16>(5 * wrap16);
+  check_expand_stamp<Ring32>(wrap32);
+  check_expand_stamp<Ring32>(3 * wrap32);
+
+  std::unique_ptr<Ring16> ring16(new Ring16());
+  check_across(*ring16, wrap16); // all the way from 0
+  std::unique_ptr<Ring16> ring16_scaled(new Ring16());
+  start_at(*ring16_scaled, 7 * wrap16 - 100);
+  check_across(*ring16_scaled, 7 * wrap16);
+  std::unique_ptr<Ring32> ring32(new Ring32());
+  start_at(*ring32, wrap32 - 1000);
+  check_across(*ring32, wrap32);
+
+  std::printf("test_compact_stamps (" RING_TEST_IMPL "): ok\n");
+  return 0;
+}
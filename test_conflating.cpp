@@ -0,0 +1,88 @@
+/* ConflatingRing: a reader that falls behind gets each updated key once with its newest value, a
+notification for a value already delivered is dropped, and under a concurrent writer the values of
+every key come out strictly increasing (never twice) and end at the last one written.
+  g++ -std=c++17 -O2 -pthread test_conflating.cpp -o test_conflating
+  g++ -std=c++17 -O2 -pthread -DRING_TEST_MPSC test_conflating.cpp -o test_conflating_mpsc
+*/
+#ifdef RING_TEST_MPSC
+#include "mpsc.cpp"
+#else
+#include "spsc.cpp"
+#endif
+#include "conflating_ring.hpp"
+#include "test.hpp"
+#include <memory>
+#include <thread>
+
+static constexpr unsigned num_keys = 8;
+
+using Ring = ConflatingRing<uint64_t, num_keys>;
+
+static void check_latest_value() {
+  std::unique_ptr<Ring> ring(new Ring());
+  uint32_t key;
+  uint64_t value;
+  TEST_CHECK(!ring->read(&key, &value));
+
+  for (uint64_t i = 1; i <= 100; ++i) {
+    uint64_t entry = i;
+    ring->write(3, &entry);
+  }
+  uint64_t entry = 7;
+  ring->write(5, &entry);
+  TEST_CHECK(ring->read(&key, &value));
+  TEST_CHECK_EQ(key, 3);
+  TEST_CHECK_EQ(value, 100);
+  TEST_CHECK(ring->read(&key, &value));
+  TEST_CHECK_EQ(key, 5);
+  TEST_CHECK_EQ(value, 7);
+  TEST_CHECK(!ring->read(&key, &value));
+
+  // what a write racing the previous read leaves behind: a notification for the delivered version
+  key = 5;
+  ring->dirty_keys.write(&key);
+  TEST_CHECK(!ring->read(&key, &value));
+  entry = 8;
+  ring->write(5, &entry);
+  TEST_CHECK(ring->read(&key, &value));
+  TEST_CHECK_EQ(key, 5);
+  TEST_CHECK_EQ(value, 8);
+}
+
+static void check_concurrent_writer() {
+  std::unique_ptr<Ring> ring(new Ring());
+  const uint64_t per_key = 100000;
+  std::thread writer([&] {
+    for (uint64_t i = 1; i <= per_key; ++i) {
+      for (uint32_t key = 0; key < num_keys; ++key) {
+        uint64_t entry = i;
+        ring->write(key, &entry);
+      }
+    }
+  });
+  uint64_t last[num_keys] = {};
+  unsigned done = 0;
+  while (done < num_keys) {
+    uint32_t key;
+    uint64_t value;
+    if (!ring->read(&key, &value)) {
+      std::this_thread::yield();
+      continue;
+    }
+    TEST_CHECK(key < num_keys);
+    TEST_CHECK(value > last[key]);
+    last[key] = value;
+    if (value == per_key) { ++done; }
+  }
+  writer.join();
+  uint32_t key;
+  uint64_t value;
+  TEST_CHECK(!ring->read(&key, &value));
+}
+
+int main() {
+  check_latest_value();
+  check_concurrent_writer();
+  std::printf("test_conflating (" RING_TEST_IMPL "): ok\n");
+  return 0;
+}
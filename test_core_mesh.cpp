@@ -0,0 +1,150 @@
+/* CoreMesh: send() reaches exactly the receiving core's drain() with the sender's index, drain()
+takes at most drain_batch per lane and comes back to a lane that filled its batch without another
+doorbell ring, wait() sleeps until a send() and returns on its timeout, and the runtime delivers
+every message between every pair of cores. SPSC only, like CoreMesh itself.
+  g++ -std=c++17 -O2 -pthread test_core_mesh.cpp -o test_core_mesh
+*/
+#include "spsc.cpp"
+#include "core_mesh.hpp"
+#include "test.hpp"
+#include <chrono>
+#include <memory>
+#include <vector>
+
+static constexpr unsigned num_cores = 3;
+static constexpr unsigned drain_batch = 4;
+
+using Mesh = CoreMesh<uint64_t, num_cores, 32, 32, 0, drain_batch>;
+
+struct Received {
+  unsigned from;
+  uint64_t value;
+};
+
+static std::vector<Received> drain_all(Mesh& mesh, unsigned core, unsigned* ret_drained = nullptr) {
+  std::vector<Received> received;
+  const unsigned drained = mesh.drain(core, [&](unsigned from, uint64_t& value) { received.push_back(Received{from, value}); });
+  TEST_CHECK_EQ(drained, received.size());
+  if (ret_drained) { *ret_drained = drained; }
+  return received;
+}
+
+static void check_send_drain() {
+  std::unique_ptr<Mesh> mesh(new Mesh());
+  uint64_t value = 10;
+  mesh->send(0, 2, &value);
+  value = 11;
+  mesh->send(1, 2, &value);
+  value = 12;
+  mesh->send(2, 0, &value);
+  TEST_CHECK(drain_all(*mesh, 1).empty());
+
+  std::vector<Received> received = drain_all(*mesh, 2);
+  TEST_CHECK_EQ(received.size(), 2);
+  TEST_CHECK_EQ(received[0].from, 0);
+  TEST_CHECK_EQ(received[0].value, 10);
+  TEST_CHECK_EQ(received[1].from, 1);
+  TEST_CHECK_EQ(received[1].value, 11);
+  TEST_CHECK(drain_all(*mesh, 2).empty());
+  received = drain_all(*mesh, 0);
+  TEST_CHECK_EQ(received.size(), 1);
+  TEST_CHECK_EQ(received[0].from, 2);
+
+  // a chatty lane gets drain_batch per drain(), the rest on the following drains without a new ring
+  for (value = 0; value < 2 * drain_batch + 1; ++value) { mesh->send(0, 1, &value); }
+  value = 100;
+  mesh->send(2, 1, &value);
+  received = drain_all(*mesh, 1);
+  TEST_CHECK_EQ(received.size(), drain_batch + 1);
+  for (unsigned i = 0; i < drain_batch; ++i) { TEST_CHECK_EQ(received[i].value, i); }
+  TEST_CHECK_EQ(received.back().from, 2);
+  TEST_CHECK_EQ(mesh->doorbells[1].pending_lanes.load(), 0);
+  TEST_CHECK_EQ(drain_all(*mesh, 1).size(), drain_batch);
+  received = drain_all(*mesh, 1);
+  TEST_CHECK_EQ(received.size(), 1);
+  TEST_CHECK_EQ(received[0].value, 2 * drain_batch);
+  TEST_CHECK(drain_all(*mesh, 1).empty());
+
+  Mesh::Core core = mesh->core(2);
+  value = 7;
+  core.send(1, &value);
+  TEST_CHECK_EQ(core.drain([](unsigned, uint64_t&) { TEST_CHECK(false); }), 0);
+  received = drain_all(*mesh, 1);
+  TEST_CHECK_EQ(received.size(), 1);
+  TEST_CHECK_EQ(received[0].from, 2);
+}
+
+static void check_wait() {
+  std::unique_ptr<Mesh> mesh(new Mesh());
+  auto start = std::chrono::steady_clock::now();
+  mesh->wait(0, 20'000'000); // nothing comes: the timeout ends it
+  TEST_CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(15));
+
+  uint64_t value = 5;
+  mesh->send(1, 0, &value);
+  start = std::chrono::steady_clock::now();
+  mesh->wait(0); // already rung: returns at once
+  TEST_CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(1));
+  TEST_CHECK_EQ(drain_all(*mesh, 0).size(), 1);
+
+  std::thread sender([&] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    uint64_t late = 6;
+    mesh->send(2, 0, &late);
+  });
+  mesh->wait(0); // no timeout: only the send wakes it
+  sender.join();
+  std::vector<Received> received = drain_all(*mesh, 0);
+  TEST_CHECK_EQ(received.size(), 1);
+  TEST_CHECK_EQ(received[0].value, 6);
+}
+
+static void check_runtime() {
+  std::unique_ptr<Mesh> mesh(new Mesh());
+  const uint64_t per_pair = 20000;
+  std::atomic<uint64_t> received_by[num_cores][num_cores] = {};
+  std::atomic<uint64_t> sent_by[num_cores] = {};
+  std::atomic<bool> order_ok{true};
+  mesh->start([&](unsigned self) {
+    Mesh::Core core = mesh->core(self);
+    uint64_t next[num_cores] = {};
+    uint64_t received = 0, sent = 0;
+    while (received < (num_cores - 1) * per_pair || sent < per_pair) { // the others may still be waiting for room to send
+      auto on_message = [&](unsigned from, uint64_t& value) {
+        if (value != next[from]++) { order_ok.store(false); }
+        received_by[self][from].fetch_add(1, std::memory_order_relaxed);
+        ++received;
+      };
+      if (sent < per_pair) {
+        bool room = true; // every lane out stays within half a lane of what its receiver drained, so nothing is overwritten
+        for (unsigned to = 0; to < num_cores; ++to) {
+          if (to != self && sent - received_by[to][self].load(std::memory_order_acquire) >= 16) { room = false; }
+        }
+        if (room) {
+          for (unsigned to = 0; to < num_cores; ++to) {
+            if (to != self) { core.send(to, &sent); }
+          }
+          sent_by[self].store(++sent, std::memory_order_relaxed);
+        }
+      }
+      if (!core.drain(on_message) && sent == per_pair) { core.wait(1'000'000); }
+      else if (sent < per_pair) { std::this_thread::yield(); }
+    }
+  }, -1);
+  mesh->join();
+  TEST_CHECK(order_ok.load());
+  for (unsigned to = 0; to < num_cores; ++to) {
+    TEST_CHECK_EQ(sent_by[to].load(), per_pair);
+    for (unsigned from = 0; from < num_cores; ++from) {
+      TEST_CHECK_EQ(received_by[to][from].load(), from == to ? 0 : per_pair);
+    }
+  }
+}
+
+int main() {
+  check_send_drain();
+  check_wait();
+  check_runtime();
+  std::printf("test_core_mesh: ok\n");
+  return 0;
+}
@@ -0,0 +1,79 @@
+/* RING_BUF_COUNTERS: failed reads and torn-read retries are counted where they happen, the counts
+of all threads add up in counters_snapshot(), and without the flag the counters take no space.
+  g++ -std=c++17 -O2 -pthread test_counters.cpp -o test_counters
+  g++ -std=c++17 -O2 -pthread -DRING_TEST_MPSC test_counters.cpp -o test_counters_mpsc
+*/
+#ifdef RING_TEST_MPSC
+#include "mpsc.cpp"
+#else
+#include "spsc.cpp"
+#endif
+#include "test.hpp"
+#include <chrono>
+#include <memory>
+#include <thread>
+
+struct Message {
+  uint64_t value;
+};
+
+using Ring = RingBuf<Message, 64, 8, RING_BUF_COUNTERS>;
+
+static_assert(std::is_empty_v<__ring_buf_counters<false>>, "disabled counters must add no members");
+
+int main() {
+  std::unique_ptr<Ring> ring(new Ring());
+  Message message{};
+  for (int i = 0; i < 3; ++i) { TEST_CHECK(!ring->read(&message)); }
+  TEST_CHECK_EQ(ring->counters_snapshot().failed_reads, 3);
+
+  // a reader that finds the region held retries until the writer commits
+  Ring::Reservation reservation = ring->reserve();
+  reservation.data->value = 1;
+  std::thread reader([&] { TEST_CHECK(ring->read(&message)); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50)); // the retries are only counted once the read is done
+  ring->commit(reservation);
+  reader.join();
+  TEST_CHECK_EQ(message.value, 1);
+  TEST_CHECK(ring->counters_snapshot().torn_read_retries > 0);
+  TEST_CHECK_EQ(ring->counters_snapshot().failed_reads, 3); // a retried read that succeeds is not a failed read
+
+#ifdef RING_TEST_MPSC
+  const unsigned writers = 4;
+#else
+  const unsigned writers = 1;
+#endif
+  const uint64_t per_writer = 10000;
+  std::atomic<uint64_t> issued{0}, consumed{0}; // each writer stays within half a ring of the reader
+  std::thread writer_threads[4];
+  for (unsigned writer = 0; writer < writers; ++writer) {
+    writer_threads[writer] = std::thread([&] {
+      Message entry{};
+      for (uint64_t i = 0; i < per_writer; ++i) {
+        while (issued.load(std::memory_order_relaxed) - consumed.load(std::memory_order_acquire) >= 32) { std::this_thread::yield(); }
+        issued.fetch_add(1, std::memory_order_relaxed);
+        ring->write(&entry);
+      }
+    });
+  }
+  uint64_t reads = 0, failed = 0;
+  while (reads < writers * per_writer) {
+    if (ring->read(&message)) {
+      consumed.store(++reads, std::memory_order_release);
+    } else {
+      ++failed;
+      std::this_thread::yield();
+    }
+  }
+  for (unsigned writer = 0; writer < writers; ++writer) { writer_threads[writer].join(); }
+
+  const RingBufCounters counters = ring->counters_snapshot();
+  TEST_CHECK_EQ(counters.failed_reads, 3 + failed); // the reader's failures land in its own block, none are lost
+  TEST_CHECK(counters.region_switches <= counters.cas_retries); // a region switch only follows a failed claim
+#ifndef RING_TEST_MPSC
+  TEST_CHECK_EQ(counters.cas_retries, 0);
+#endif
+  std::printf("test_counters (" RING_TEST_IMPL "): %llu failed reads, %llu torn-read retries, %llu CAS retries\n",
+    (unsigned long long)counters.failed_reads, (unsigned long long)counters.torn_read_retries, (unsigned long long)counters.cas_retries);
+  return 0;
+}
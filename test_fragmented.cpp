@@ -0,0 +1,83 @@
+/* FragmentedRing: messages of every size up to max_message_size, including empty ones, come back
+intact through read() and consume(), oversized ones are refused, and fragments that do not form a
+message (after a seek() into the middle of one, or a last fragment without FRAGMENT_LAST) are
+dropped instead of being handed out. SPSC only, like FragmentedRing itself.
+  g++ -std=c++17 -O2 -pthread test_fragmented.cpp -o test_fragmented
+*/
+#include "spsc.cpp"
+#include "fragmented_ring.hpp"
+#include "test.hpp"
+#include <memory>
+#include <vector>
+
+using Channel = FragmentedRing<16, 16>; // messages of up to 128 bytes
+
+static std::vector<unsigned char> make_message(uint64_t size, unsigned char seed) {
+  std::vector<unsigned char> message(size);
+  for (uint64_t i = 0; i < size; ++i) { message[i] = (unsigned char)(seed + i * 7); }
+  return message;
+}
+
+static void check_round_trip(Channel& channel, uint64_t size, unsigned char seed) {
+  const std::vector<unsigned char> message = make_message(size, seed);
+  TEST_CHECK(channel.write(message.data(), size));
+  unsigned char buffer[Channel::max_message_size];
+  uint64_t read_size = UINT64_MAX;
+  if (size) {
+    TEST_CHECK(!channel.read(buffer, size - 1, &read_size)); // too small: left in the ring
+    TEST_CHECK_EQ(read_size, size);
+  }
+  TEST_CHECK(channel.read(buffer, sizeof(buffer), &read_size));
+  TEST_CHECK_EQ(read_size, size);
+  TEST_CHECK(std::equal(message.begin(), message.end(), buffer));
+  TEST_CHECK(!channel.read(buffer, sizeof(buffer), &read_size)); // none left, which is not an empty message
+  TEST_CHECK_EQ(read_size, 0);
+}
+
+int main() {
+  std::unique_ptr<Channel> channel(new Channel());
+  for (uint64_t size : {0, 1, 15, 16, 17, 100, 128}) { check_round_trip(*channel, size, (unsigned char)size); }
+  TEST_CHECK(channel->write("", 0));
+  TEST_CHECK(channel->consume([](const Channel::FragmentedMessage& empty) {
+    TEST_CHECK_EQ(empty.size, 0);
+    TEST_CHECK_EQ(empty.fragments, 1);
+    TEST_CHECK(empty.contiguous());
+  }));
+  TEST_CHECK(!channel->write(make_message(129, 0).data(), 129));
+
+  const std::vector<unsigned char> message = make_message(40, 3); // 3 fragments
+  TEST_CHECK(channel->write(message.data(), message.size()));
+  TEST_CHECK(channel->consume([&](const Channel::FragmentedMessage& in_place) {
+    TEST_CHECK_EQ(in_place.size, 40);
+    TEST_CHECK_EQ(in_place.fragments, 3);
+    TEST_CHECK(!in_place.contiguous());
+    std::vector<unsigned char> copy(in_place.size);
+    in_place.copy_to(copy.data());
+    TEST_CHECK(copy == message);
+  }));
+  TEST_CHECK(!channel->consume([](const Channel::FragmentedMessage&) { TEST_CHECK(false); }));
+
+  // a reader that lands on the middle of a message skips to the next one
+  TEST_CHECK(channel->write(message.data(), message.size()));
+  TEST_CHECK(channel->write(message.data(), 5));
+  TEST_CHECK(channel->ring.seek(channel->ring.read_sequence_number + 2));
+  unsigned char buffer[Channel::max_message_size];
+  uint64_t read_size = 0;
+  TEST_CHECK(channel->read(buffer, sizeof(buffer), &read_size));
+  TEST_CHECK_EQ(read_size, 5);
+  TEST_CHECK_EQ(channel->dropped_fragments, 2);
+
+  // a message whose last fragment does not say so is dropped whole
+  TEST_CHECK(channel->write(message.data(), 20)); // 2 fragments
+  TEST_CHECK(channel->write(message.data(), 7));
+  Fragment<16>* last = channel->ring.front(1);
+  TEST_CHECK(last);
+  last->fragment_flags &= ~(uint32_t)FRAGMENT_LAST;
+  TEST_CHECK(channel->read(buffer, sizeof(buffer), &read_size));
+  TEST_CHECK_EQ(read_size, 7);
+  TEST_CHECK_EQ(channel->dropped_fragments, 4);
+  TEST_CHECK(std::equal(message.begin(), message.begin() + 7, buffer));
+
+  std::printf("test_fragmented: ok\n");
+  return 0;
+}
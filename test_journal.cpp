@@ -0,0 +1,127 @@
+/* JournalRing across a simulated crash (the journal is closed with a reservation never committed,
+which is what a writer that died mid-write leaves behind): reopening recovers every committed
+entry, replay() and sync() stop at entries that are claimed but not written yet, and a second
+open() of a journal in use attaches to it without recovering it under the live writer, and a
+journal of another shape with the same sizes is refused.
+  g++ -std=c++17 -O2 -pthread test_journal.cpp -o test_journal
+  g++ -std=c++17 -O2 -pthread -DRING_TEST_MPSC test_journal.cpp -o test_journal_mpsc
+*/
+#ifdef RING_TEST_MPSC
+#include "mpsc.cpp"
+#else
+#include "spsc.cpp"
+#endif
+#include "journal_ring.hpp"
+#include "test.hpp"
+#include <vector>
+
+struct Message {
+  uint64_t value;
+};
+
+struct OtherMessage { // same size as Message
+  uint64_t count;
+};
+
+using Journal = JournalRing<Message, 16, 4>;
+
+static void write_value(Journal& journal, uint64_t value) {
+  Message message{value};
+  journal.write(&message);
+}
+
+static std::vector<uint64_t> replay_all(Journal& journal, uint64_t from_seq, uint64_t expected_resume) {
+  std::vector<uint64_t> values;
+  const uint64_t resume = journal.replay(from_seq, [&](uint64_t seq, const Message& message) {
+    TEST_CHECK_EQ(message.value, seq);
+    values.push_back(seq);
+  });
+  TEST_CHECK_EQ(resume, expected_resume);
+  return values;
+}
+
+int main() {
+  char path[64];
+  std::snprintf(path, sizeof(path), "/tmp/test_journal_%d", (int)getpid());
+  unlink(path);
+
+  { // crash with an entry claimed but never written
+    Journal journal;
+    TEST_CHECK(journal.open(path));
+    TEST_CHECK_EQ(journal.recovered_sequence_number, 0);
+    for (uint64_t value = 1; value <= 3; ++value) { write_value(journal, value); }
+    journal.ring->reserve(); // 4
+#ifdef RING_TEST_MPSC
+    write_value(journal, 5); // completes while 4 is still claimed
+#endif
+  }
+
+  {
+    Journal journal;
+    TEST_CHECK(journal.open(path));
+#ifdef RING_TEST_MPSC
+    TEST_CHECK_EQ(journal.recovered_sequence_number, 5);
+    TEST_CHECK((replay_all(journal, 1, 6) == std::vector<uint64_t>{1, 2, 3, 5})); // the gap at 4 is skipped
+#else
+    TEST_CHECK_EQ(journal.recovered_sequence_number, 3);
+    TEST_CHECK((replay_all(journal, 1, 4) == std::vector<uint64_t>{1, 2, 3}));
+#endif
+    TEST_CHECK(journal.sync());
+    TEST_CHECK_EQ(journal.header->synced_sequence_number.load(), journal.recovered_sequence_number);
+    Message message{};
+    for (uint64_t value = 1; value <= 3; ++value) {
+      TEST_CHECK(journal.read(&message));
+      TEST_CHECK_EQ(message.value, value);
+    }
+#ifdef RING_TEST_MPSC
+    TEST_CHECK(journal.read(&message));
+    TEST_CHECK_EQ(message.value, 5);
+    TEST_CHECK_EQ(journal.lost_entries, 1);
+#endif
+    TEST_CHECK(!journal.read(&message));
+    const uint64_t next = journal.recovered_sequence_number + 1;
+
+    /* A claim whose writer has not started writing yet (the write sequence number is advanced
+    before anything else) is where replay() and sync() stop. */
+    __atomic_fetch_add(&journal.ring->prod_u.write_sequence_number, 1, __ATOMIC_RELAXED);
+    TEST_CHECK(replay_all(journal, next, next).empty());
+    TEST_CHECK(journal.sync());
+    TEST_CHECK_EQ(journal.header->synced_sequence_number.load(), next - 1);
+    __atomic_fetch_sub(&journal.ring->prod_u.write_sequence_number, 1, __ATOMIC_RELAXED);
+
+    write_value(journal, next);
+    write_value(journal, next + 1);
+    TEST_CHECK((replay_all(journal, next, next + 2) == std::vector<uint64_t>{next, next + 1}));
+    TEST_CHECK(journal.sync());
+    TEST_CHECK_EQ(journal.header->synced_sequence_number.load(), next + 1);
+
+    // a second open() while this one is live attaches without recovering the held region
+    Journal::Ring::Reservation reservation = journal.ring->reserve();
+    const uint64_t held = journal.ring->version_numbers[(reservation.sequence_number - 1) & 3].number.load();
+    Journal attached;
+    TEST_CHECK(attached.open(path));
+    TEST_CHECK_EQ(attached.recovered_sequence_number, journal.recovered_sequence_number);
+    TEST_CHECK_EQ(attached.ring->version_numbers[(reservation.sequence_number - 1) & 3].number.load(), held);
+    *reservation.data = Message{next + 2};
+    journal.ring->commit(reservation);
+    TEST_CHECK(attached.read(&message));
+    TEST_CHECK_EQ(message.value, next);
+  }
+
+  { // the same ring size, but another DataType or stamp width
+    JournalRing<OtherMessage, 16, 4> other_type;
+    static_assert(sizeof(JournalRing<OtherMessage, 16, 4>::Ring) == sizeof(Journal::Ring), "");
+    TEST_CHECK(!other_type.open(path));
+    TEST_CHECK_EQ(errno, EINVAL);
+    JournalRing<Message, 16, 4, RING_BUF_STAMP32> other_stamp;
+    static_assert(sizeof(JournalRing<Message, 16, 4, RING_BUF_STAMP32>::Ring) == sizeof(Journal::Ring), "");
+    TEST_CHECK(!other_stamp.open(path));
+    TEST_CHECK_EQ(errno, EINVAL);
+    Journal journal;
+    TEST_CHECK(journal.open(path));
+  }
+
+  unlink(path);
+  std::printf("test_journal (" RING_TEST_IMPL "): ok\n");
+  return 0;
+}
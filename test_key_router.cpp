@@ -0,0 +1,78 @@
+/* KeyRouter: producer indices are reused after detach(), and every key stays in order across a
+rebalance() that moves its bucket to another consumer, with the new owner reading before the old
+one has drained (so it has to hold the moved entries back). Single-threaded, so the interleaving
+is exact.
+  g++ -std=c++17 -O2 -pthread test_key_router.cpp -o test_key_router
+*/
+#include "mpsc.cpp"
+#include "key_router.hpp"
+#include "test.hpp"
+#include <memory>
+
+struct Keyed {
+  uint64_t key;
+  uint64_t seq; // per key
+};
+
+struct KeyOfKeyed {
+  uint64_t operator()(const Keyed& entry) const { return entry.key; }
+};
+
+static constexpr unsigned num_keys = 32, num_buckets = 16;
+using Router = KeyRouter<Keyed, KeyOfKeyed, 2, 1024, num_buckets>;
+
+static uint64_t written[num_keys], next_expected[num_keys];
+
+static void write_round(Router& router, unsigned producer) {
+  for (uint64_t key = 0; key < num_keys; ++key) {
+    Keyed entry{key, ++written[key]};
+    router.write(producer, &entry);
+  }
+}
+
+static uint64_t drain(Router& router, unsigned consumer) {
+  Keyed entry;
+  uint64_t count = 0;
+  while (router.read(consumer, &entry)) {
+    TEST_CHECK_EQ(entry.seq, ++next_expected[entry.key]);
+    ++count;
+  }
+  return count;
+}
+
+int main() {
+  std::unique_ptr<Router> router(new Router());
+
+  for (int producer = 0; producer < (int)Router::max_producers; ++producer) { TEST_CHECK_EQ(router->attach(), producer); }
+  TEST_CHECK_EQ(router->attach(), -1);
+  router->detach(5);
+  router->detach(63);
+  TEST_CHECK_EQ(router->attach(), 5);
+  TEST_CHECK_EQ(router->attach(), 63);
+  TEST_CHECK_EQ(router->attach(), -1);
+
+  write_round(*router, 0);
+  write_round(*router, 5);
+  uint64_t keys_of_1 = 0; // in the epoch-1 table
+  for (uint64_t key = 0; key < num_keys; ++key) { keys_of_1 += router->owners[1][Router::bucket_of(Keyed{key, 0})] == 1; }
+  const uint64_t keys_of_0 = num_keys - keys_of_1;
+  uint16_t swapped[num_buckets];
+  for (unsigned bucket = 0; bucket < num_buckets; ++bucket) { swapped[bucket] = 1 - router->owners[1][bucket]; }
+  TEST_CHECK(router->rebalance(swapped));
+  write_round(*router, 63);
+  TEST_CHECK(!router->rebalance(swapped)); // nobody has drained epoch 1 yet
+
+  // consumer 1 now owns consumer 0's old buckets, but must hold their new entries back
+  TEST_CHECK_EQ(drain(*router, 1), 2 * keys_of_1); // its own epoch-1 entries only, after which it has drained epoch 1
+  TEST_CHECK_EQ(drain(*router, 0), 2 * keys_of_0 + keys_of_1); // consumer 1's old keys need not wait any more
+  TEST_CHECK_EQ(drain(*router, 1), keys_of_0); // the held-back entries, now that consumer 0 has drained epoch 1 too
+  TEST_CHECK_EQ(drain(*router, 0) + drain(*router, 1), 0);
+  for (uint64_t key = 0; key < num_keys; ++key) { TEST_CHECK_EQ(next_expected[key], 3); }
+
+  TEST_CHECK(router->rebalance(swapped)); // both drained epoch 1
+  write_round(*router, 0);
+  TEST_CHECK_EQ(drain(*router, 0) + drain(*router, 1) + drain(*router, 0) + drain(*router, 1), num_keys);
+
+  std::printf("test_key_router: ok\n");
+  return 0;
+}
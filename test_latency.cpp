@@ -0,0 +1,77 @@
+/* RING_BUF_LATENCY with messages smaller than a cache line, which is most of them: the flag must
+compile, leave the slot size alone and record one sample per entry read, through read() as
+well as through reserve()/commit() and consume(). The write time goes in the slot padding, e.g.,
+behind a message just over ALIGN_NO_FALSE_SHARING, or in the side array when there is no room.
+  g++ -std=c++17 -O2 -pthread test_latency.cpp -o test_latency
+  g++ -std=c++17 -O2 -pthread -DRING_TEST_MPSC test_latency.cpp -o test_latency_mpsc
+*/
+#ifdef RING_TEST_MPSC
+#include "mpsc.cpp"
+#else
+#include "spsc.cpp"
+#endif
+#include "test.hpp"
+
+struct SmallMessage {
+  uint64_t value;
+};
+
+struct OddMessage {
+  uint64_t value;
+  uint32_t tag;
+  char name[12];
+};
+
+struct FullMessage { // with its stamp, exactly one ALIGN_NO_FALSE_SHARING block: no padding left
+  uint64_t value;
+  char rest[ALIGN_NO_FALSE_SHARING - 2 * sizeof(uint64_t)];
+};
+
+struct PaddedMessage { // the slot is rounded up to two blocks
+  uint64_t value;
+  char rest[ALIGN_NO_FALSE_SHARING];
+};
+
+template<typename Message>
+static void check_latency_ring() {
+  using Ring = RingBuf<Message, 16, 4, RING_BUF_LATENCY>;
+  using PlainRing = RingBuf<Message, 16, 4>;
+  static_assert(sizeof(typename Ring::versioned_DataType) == sizeof(typename PlainRing::versioned_DataType), "the flag must not change the slot");
+  constexpr bool padded = sizeof(typename PlainRing::versioned_DataType) - sizeof(typename PlainRing::__unaligned_versioned_DataType) >= sizeof(uint64_t);
+  static_assert(Ring::__slot_layout::write_tsc_in_slot == padded, "the write time goes in the padding iff it fits");
+
+  Ring ring;
+  Message message{};
+  for (uint64_t value = 1; value <= 10; ++value) {
+    message.value = value;
+    ring.write(&message);
+  }
+  for (uint64_t value = 1; value <= 10; ++value) {
+    TEST_CHECK(ring.read(&message));
+    TEST_CHECK_EQ(message.value, value);
+  }
+  TEST_CHECK(!ring.read(&message)); // an empty read records nothing
+  TEST_CHECK_EQ(ring.latency_histogram.count(), 10);
+
+  for (uint64_t value = 11; value <= 14; ++value) {
+    typename Ring::Reservation reservation = ring.reserve();
+    new (reservation.data) Message{};
+    reservation.data->value = value;
+    ring.commit(reservation);
+  }
+  for (uint64_t value = 11; value <= 14; ++value) {
+    TEST_CHECK(ring.consume([&](Message&& entry) { TEST_CHECK_EQ(entry.value, value); }));
+  }
+  TEST_CHECK_EQ(ring.latency_histogram.count(), 14);
+}
+
+int main() {
+  check_latency_ring<SmallMessage>();
+  check_latency_ring<OddMessage>();
+  check_latency_ring<FullMessage>();
+  check_latency_ring<PaddedMessage>();
+  static_assert(!RingBuf<FullMessage, 16, 4, RING_BUF_LATENCY>::__slot_layout::write_tsc_in_slot, "no room in the padding");
+  static_assert(RingBuf<PaddedMessage, 16, 4, RING_BUF_LATENCY>::__slot_layout::write_tsc_in_slot, "room in the padding");
+  std::printf("test_latency (" RING_TEST_IMPL "): ok\n");
+  return 0;
+}
@@ -0,0 +1,140 @@
+/* Non-POD entries through reserve()/commit(), emplace(), consume() and take(): std::string and the
+move-only std::unique_ptr round-trip intact over several laps of the ring, and every object put in
+is destroyed exactly once, by whoever ends up owning it, never by the ring while it holds it.
+  g++ -std=c++17 -O2 -pthread test_non_pod.cpp -o test_non_pod
+  g++ -std=c++17 -O2 -pthread -DRING_TEST_MPSC test_non_pod.cpp -o test_non_pod_mpsc
+*/
+#ifdef RING_TEST_MPSC
+#include "mpsc.cpp"
+#else
+#include "spsc.cpp"
+#endif
+#include "test.hpp"
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct Payload {
+  static std::atomic<uint64_t> destroyed;
+  uint64_t value;
+  explicit Payload(uint64_t value) : value(value) {}
+  ~Payload() { destroyed.fetch_add(1, std::memory_order_relaxed); }
+};
+std::atomic<uint64_t> Payload::destroyed{0};
+
+// long enough to live on the heap rather than in the small-string buffer
+static std::string long_string(uint64_t i) { return "entry " + std::to_string(i) + std::string(40, 'x'); }
+
+static void check_strings() {
+  std::unique_ptr<RingBuf<std::string, 8, 2>> ring(new RingBuf<std::string, 8, 2>());
+  std::string entry;
+  TEST_CHECK(!ring->take(&entry));
+  for (uint64_t lap = 0; lap < 5; ++lap) { // 30 entries through 8 slots
+    const uint64_t first = lap * 6;
+    ring->emplace(long_string(first));
+    ring->emplace(long_string(first + 1).c_str());
+    std::string moved = long_string(first + 2);
+    ring->emplace(std::move(moved));
+    for (uint64_t i = first + 3; i < first + 6; ++i) {
+      auto reservation = ring->reserve();
+      new (reservation.data) std::string(long_string(i));
+      ring->commit(reservation);
+    }
+
+    for (uint64_t i = first; i < first + 3; ++i) {
+      TEST_CHECK(ring->take(&entry));
+      TEST_CHECK(entry == long_string(i));
+    }
+    for (uint64_t i = first + 3; i < first + 6; ++i) {
+      bool matches = false;
+      TEST_CHECK(ring->consume([&](std::string&& in_slot) { matches = in_slot == long_string(i); }));
+      TEST_CHECK(matches);
+    }
+    TEST_CHECK(!ring->take(&entry));
+  }
+}
+
+static void check_unique_ptrs() {
+  using Ring = RingBuf<std::unique_ptr<Payload>, 8, 2>;
+  std::unique_ptr<Ring> ring(new Ring());
+  Payload::destroyed.store(0);
+  std::unique_ptr<Payload> entry;
+  for (uint64_t i = 1; i <= 20; ++i) {
+    ring->emplace(new Payload(i));
+    TEST_CHECK(ring->take(&entry));
+    TEST_CHECK_EQ(entry->value, i);
+    TEST_CHECK_EQ(Payload::destroyed.load(), i - 1); // the previous payload, replaced by the take
+  }
+  entry.reset();
+  TEST_CHECK_EQ(Payload::destroyed.load(), 20);
+
+  // consume() destroys the moved-from pointer in its slot, which must not delete the payload again
+  std::vector<std::unique_ptr<Payload>> kept;
+  for (uint64_t i = 1; i <= 3; ++i) {
+    auto reservation = ring->reserve();
+    new (reservation.data) std::unique_ptr<Payload>(new Payload(i));
+    ring->commit(reservation);
+  }
+  while (ring->consume([&](std::unique_ptr<Payload>&& in_slot) { kept.push_back(std::move(in_slot)); })) {}
+  TEST_CHECK_EQ(kept.size(), 3);
+  TEST_CHECK_EQ(Payload::destroyed.load(), 20);
+  kept.clear();
+  TEST_CHECK_EQ(Payload::destroyed.load(), 23);
+
+  // an entry consumed without being moved from is destroyed in its slot
+  ring->emplace(new Payload(24));
+  TEST_CHECK(ring->consume([](std::unique_ptr<Payload>&& in_slot) { TEST_CHECK_EQ(in_slot->value, 24); }));
+  TEST_CHECK_EQ(Payload::destroyed.load(), 24);
+}
+
+static void check_concurrent_writers() {
+#ifdef RING_TEST_MPSC
+  const unsigned writers = 4;
+#else
+  const unsigned writers = 1;
+#endif
+  const uint64_t per_writer = 20000;
+  using Ring = RingBuf<std::unique_ptr<Payload>, 64, 8>;
+  std::unique_ptr<Ring> ring(new Ring());
+  Payload::destroyed.store(0);
+  std::atomic<uint64_t> issued{0}, consumed{0}; // all writers together stay within half a ring of the reader
+  std::vector<std::thread> writer_threads;
+  for (unsigned writer = 0; writer < writers; ++writer) {
+    writer_threads.emplace_back([&, writer] {
+      for (uint64_t i = 0; i < per_writer; ++i) {
+        while (issued.fetch_add(1, std::memory_order_relaxed) - consumed.load(std::memory_order_acquire) >= 32) {
+          issued.fetch_sub(1, std::memory_order_relaxed);
+          std::this_thread::yield();
+        }
+        ring->emplace(new Payload(writer * per_writer + i));
+      }
+    });
+  }
+  std::vector<uint64_t> next(writers, 0);
+  std::unique_ptr<Payload> entry;
+  uint64_t reads = 0;
+  while (reads < writers * per_writer) {
+    if (!ring->take(&entry)) {
+      std::this_thread::yield();
+      continue;
+    }
+    consumed.store(++reads, std::memory_order_release);
+    const uint64_t writer = entry->value / per_writer;
+    TEST_CHECK(writer < writers);
+    TEST_CHECK_EQ(entry->value % per_writer, next[writer]); // in order per writer, none lost or repeated
+    ++next[writer];
+  }
+  for (std::thread& thread : writer_threads) { thread.join(); }
+  entry.reset();
+  TEST_CHECK(!ring->take(&entry));
+  TEST_CHECK_EQ(Payload::destroyed.load(), writers * per_writer);
+}
+
+int main() {
+  check_strings();
+  check_unique_ptrs();
+  check_concurrent_writers();
+  std::printf("test_non_pod (" RING_TEST_IMPL "): ok\n");
+  return 0;
+}
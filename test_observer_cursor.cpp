@@ -0,0 +1,95 @@
+/* ObserverCursor: it sees every entry in order without disturbing the consumer, a cursor lapped by
+the writers counts the overwritten entries in missed and resumes at the oldest retained one, and a
+cursor behind_consumer never passes the consumer.
+  g++ -std=c++17 -O2 -pthread test_observer_cursor.cpp -o test_observer_cursor
+  g++ -std=c++17 -O2 -pthread -DRING_TEST_MPSC test_observer_cursor.cpp -o test_observer_cursor_mpsc
+*/
+#ifdef RING_TEST_MPSC
+#include "mpsc.cpp"
+#else
+#include "spsc.cpp"
+#endif
+#include "observer_cursor.hpp"
+#include "test.hpp"
+
+struct Message {
+  uint64_t value;
+};
+
+using Ring = RingBuf<Message, 8, 2>;
+using Cursor = ObserverCursor<Message, 8, 2>;
+
+static void write_values(Ring& ring, uint64_t first, uint64_t last) {
+  for (uint64_t value = first; value <= last; ++value) {
+    Message message{value};
+    ring.write(&message);
+  }
+}
+
+static void check_lapped() {
+  Ring ring;
+  Cursor cursor(&ring);
+  Message message{};
+  uint64_t seq = 0;
+  TEST_CHECK(!cursor.next(&message, &seq));
+
+  write_values(ring, 1, 3);
+  TEST_CHECK_EQ(cursor.lag(), 3);
+  for (uint64_t value = 1; value <= 3; ++value) {
+    TEST_CHECK(cursor.next(&message, &seq));
+    TEST_CHECK_EQ(seq, value);
+    TEST_CHECK_EQ(message.value, value);
+  }
+  TEST_CHECK(!cursor.next(&message, &seq));
+  TEST_CHECK_EQ(cursor.missed, 0);
+
+  write_values(ring, 4, 23); // 16..23 are retained
+  TEST_CHECK_EQ(cursor.lag(), 20);
+  for (uint64_t value = 16; value <= 23; ++value) {
+    TEST_CHECK(cursor.next(&message, &seq));
+    TEST_CHECK_EQ(seq, value);
+    TEST_CHECK_EQ(message.value, value);
+  }
+  TEST_CHECK_EQ(cursor.missed, 12); // 4..15
+  TEST_CHECK(!cursor.next(&message, &seq));
+  TEST_CHECK_EQ(cursor.lag(), 0);
+  TEST_CHECK_EQ(ring.read_sequence_number, 0); // the consumer did not move
+}
+
+static void check_behind_consumer() {
+  Ring ring;
+  Cursor behind(&ring, true), alongside(&ring);
+  write_values(ring, 1, 5);
+  Message message{};
+  uint64_t seq = 0;
+  TEST_CHECK(!behind.next(&message, &seq)); // nothing consumed yet
+  TEST_CHECK(alongside.next(&message, &seq));
+  TEST_CHECK_EQ(seq, 1);
+
+  for (uint64_t value = 1; value <= 2; ++value) {
+    TEST_CHECK(ring.read(&message));
+    TEST_CHECK_EQ(message.value, value);
+  }
+  for (uint64_t value = 1; value <= 2; ++value) {
+    TEST_CHECK(behind.next(&message, &seq));
+    TEST_CHECK_EQ(seq, value);
+    TEST_CHECK_EQ(message.value, value);
+  }
+  TEST_CHECK(!behind.next(&message, &seq));
+
+  behind.skip_to_newest();
+  alongside.skip_to_newest();
+  TEST_CHECK_EQ(behind.next_sequence_number, 3);
+  TEST_CHECK_EQ(alongside.next_sequence_number, 6);
+  TEST_CHECK(ring.read(&message));
+  TEST_CHECK(behind.next(&message, &seq));
+  TEST_CHECK_EQ(message.value, 3);
+  TEST_CHECK(!alongside.next(&message, &seq));
+}
+
+int main() {
+  check_lapped();
+  check_behind_consumer();
+  std::printf("test_observer_cursor (" RING_TEST_IMPL "): ok\n");
+  return 0;
+}
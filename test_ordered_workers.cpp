@@ -0,0 +1,75 @@
+/* OrderedWorkers: results come out in input order whatever order the workers finish in, dispatch()
+stops at window positions in flight, and with worker threads emitting themselves (no sequencer)
+every result is emitted exactly once, in order. SPSC only, like OrderedWorkers itself.
+  g++ -std=c++17 -O2 -pthread test_ordered_workers.cpp -o test_ordered_workers
+*/
+#include "spsc.cpp"
+#include "ordered_workers.hpp"
+#include "test.hpp"
+#include <memory>
+#include <sched.h>
+#include <thread>
+#include <vector>
+
+static constexpr unsigned num_workers = 3;
+
+static void square(const uint64_t& input, uint64_t* output) { *output = input * input; }
+
+static void check_out_of_order_completion() {
+  std::unique_ptr<OrderedWorkers<uint64_t, uint64_t, num_workers, 8>> pool(new OrderedWorkers<uint64_t, uint64_t, num_workers, 8>());
+  for (uint64_t input = 0; input < 8; ++input) { TEST_CHECK(pool->dispatch(&input)); }
+  uint64_t input = 8;
+  TEST_CHECK(!pool->dispatch(&input)); // the window is full
+
+  std::vector<uint64_t> outputs;
+  auto collect = [&](uint64_t& output) { outputs.push_back(output); };
+  while (pool->work(2, square)) {} // positions 2 and 5
+  while (pool->work(1, square)) {} // 1, 4 and 7
+  TEST_CHECK_EQ(pool->emit(collect), 0); // position 0 is not done
+  TEST_CHECK(!pool->dispatch(&input));
+  TEST_CHECK(pool->work(0, square)); // 0
+  TEST_CHECK_EQ(pool->emit(collect), 3); // 0, 1, 2; 3 is not done
+  TEST_CHECK(pool->dispatch(&input)); // position 8, worker 2
+  while (pool->work(0, square)) {} // 3 and 6
+  TEST_CHECK_EQ(pool->emit(collect), 5); // 3 to 7
+  TEST_CHECK(pool->work(2, square, collect)); // 8, emitted by the worker
+  TEST_CHECK_EQ(outputs.size(), 9);
+  for (uint64_t position = 0; position < outputs.size(); ++position) { TEST_CHECK_EQ(outputs[position], position * position); }
+}
+
+static void check_worker_threads() {
+  static constexpr uint64_t inputs = 20000;
+  std::unique_ptr<OrderedWorkers<uint64_t, uint64_t, num_workers, 64>> pool(new OrderedWorkers<uint64_t, uint64_t, num_workers, 64>());
+  std::vector<uint64_t> outputs; // appended to by whichever thread emits; only one does at a time
+  outputs.reserve(inputs);
+  std::atomic<bool> stop{false};
+  std::thread workers[num_workers];
+  for (unsigned worker = 0; worker < num_workers; ++worker) {
+    workers[worker] = std::thread([&, worker] {
+      auto process = [](const uint64_t& input, uint64_t* output) {
+        if (!(input % 7)) { sched_yield(); } // finish out of order
+        *output = input * input;
+      };
+      auto collect = [&](uint64_t& output) { outputs.push_back(output); };
+      while (!stop.load(std::memory_order_acquire)) {
+        if (!pool->work(worker, process, collect)) { sched_yield(); }
+      }
+    });
+  }
+  for (uint64_t input = 0; input < inputs; ++input) {
+    while (!pool->dispatch(&input)) { sched_yield(); }
+  }
+  while (pool->next_emit_position.load(std::memory_order_acquire) < inputs) { sched_yield(); }
+  stop.store(true, std::memory_order_release);
+  for (std::thread& worker : workers) { worker.join(); }
+
+  TEST_CHECK_EQ(outputs.size(), inputs);
+  for (uint64_t position = 0; position < inputs; ++position) { TEST_CHECK_EQ(outputs[position], position * position); }
+}
+
+int main() {
+  check_out_of_order_completion();
+  check_worker_threads();
+  std::printf("test_ordered_workers: ok\n");
+  return 0;
+}
@@ -0,0 +1,68 @@
+/* PacketPool: buffers run out and come back through release(), reference counts keep a shared
+buffer out of the pool, and the headroom and tailroom limits hold for every adjustment: append()
+never reaches into the reserved tailroom, which only append_trailer() uses.
+  g++ -std=c++17 -O2 -pthread test_packet_pool.cpp -o test_packet_pool
+*/
+#include "spsc.cpp"
+#include "packet_pool.hpp"
+#include "test.hpp"
+#include <memory>
+
+using Pool = PacketPool<256, 4, 32, 16>;
+
+int main() {
+  std::unique_ptr<Pool> pool(new Pool());
+  static_assert(Pool::data_room == 208, "256 bytes less 32 of headroom and 16 of tailroom");
+
+  PacketDescriptor descriptors[4];
+  for (PacketDescriptor& descriptor : descriptors) {
+    TEST_CHECK(pool->alloc(&descriptor));
+    TEST_CHECK_EQ(descriptor.data_offset, 32);
+    TEST_CHECK_EQ(descriptor.data_length, 0);
+  }
+  PacketDescriptor descriptor;
+  TEST_CHECK(!pool->alloc(&descriptor)); // all 4 are out
+
+  // fill a packet up to the tailroom, then add a trailer into it
+  PacketDescriptor& packet = descriptors[0];
+  TEST_CHECK_EQ(pool->tailroom_left(packet), Pool::data_room);
+  unsigned char* payload = pool->append(&packet, Pool::data_room);
+  TEST_CHECK(payload == pool->data(packet));
+  std::memset(payload, 0xab, Pool::data_room);
+  TEST_CHECK_EQ(pool->tailroom_left(packet), 0);
+  TEST_CHECK(!pool->append(&packet, 1));
+  TEST_CHECK(pool->append_trailer(&packet, 16) == payload + Pool::data_room);
+  TEST_CHECK(!pool->append_trailer(&packet, 1));
+  TEST_CHECK_EQ(packet.data_length, Pool::data_room + 16);
+  TEST_CHECK_EQ(pool->tailroom_left(packet), 0);
+
+  // headers go into the headroom and back out without moving the payload
+  TEST_CHECK(!pool->prepend(&packet, 33));
+  unsigned char* header = pool->prepend(&packet, 14);
+  TEST_CHECK(header == payload - 14);
+  TEST_CHECK_EQ(pool->headroom_left(packet), 18);
+  TEST_CHECK(pool->strip(&packet, 14) == header);
+  TEST_CHECK(pool->data(packet) == payload);
+  TEST_CHECK(pool->trim(&packet, 16) == payload + Pool::data_room);
+  TEST_CHECK(!pool->trim(&packet, Pool::data_room + 1));
+  TEST_CHECK(!pool->strip(&packet, Pool::data_room + 1));
+  TEST_CHECK_EQ(packet.data_length, Pool::data_room);
+  TEST_CHECK_EQ(payload[Pool::data_room - 1], 0xab);
+
+  // a descriptor passed over a PacketRing to a second owner keeps the buffer until both release it
+  PacketRing<4> ring;
+  pool->retain(packet);
+  ring.write(&packet);
+  pool->release(packet);
+  TEST_CHECK(!pool->alloc(&descriptor));
+  PacketDescriptor received;
+  TEST_CHECK(ring.read(&received));
+  TEST_CHECK(pool->data(received) == payload);
+  pool->release(received);
+  TEST_CHECK(pool->alloc(&descriptor));
+  TEST_CHECK_EQ(descriptor.buffer_index, packet.buffer_index);
+  TEST_CHECK_EQ(descriptor.data_length, 0);
+
+  std::printf("test_packet_pool: ok\n");
+  return 0;
+}
@@ -0,0 +1,96 @@
+/* PriorityLanes: read_strict takes lane 0 ahead of a full bulk lane, read_weighted takes weights[lane]
+entries from each lane in turn, starting with lane 0 on the first call after the weights are set,
+and both skip empty lanes.
+  g++ -std=c++17 -O2 -pthread test_priority_lanes.cpp -o test_priority_lanes
+*/
+#include "spsc.cpp"
+#include "priority_lanes.hpp"
+#include "test.hpp"
+#include <memory>
+
+static constexpr unsigned lane_length = 16;
+static constexpr unsigned num_lanes = 3;
+
+struct LaneMessage {
+  unsigned lane;
+  uint64_t seq;
+};
+
+using Lanes = PriorityLanes<LaneMessage, lane_length, num_lanes>;
+
+static void fill(Lanes& lanes, unsigned lane, uint64_t count) {
+  for (uint64_t seq = 1; seq <= count; ++seq) {
+    LaneMessage message{lane, seq};
+    lanes.write(lane, &message);
+  }
+}
+
+static void check_strict() {
+  std::unique_ptr<Lanes> lanes(new Lanes());
+  LaneMessage message;
+  unsigned lane;
+  TEST_CHECK(!lanes->read_strict(&message, &lane));
+
+  fill(*lanes, 2, lane_length); // the bulk lane is full, lane 1 stays empty
+  TEST_CHECK(lanes->read_strict(&message, &lane));
+  TEST_CHECK_EQ(lane, 2);
+  TEST_CHECK_EQ(message.seq, 1);
+
+  LaneMessage cancel{0, 1};
+  lanes->write(0, &cancel);
+  TEST_CHECK(lanes->read_strict(&message, &lane)); // jumps the bulk backlog
+  TEST_CHECK_EQ(lane, 0);
+  TEST_CHECK_EQ(message.lane, 0);
+  for (uint64_t seq = 2; seq <= lane_length; ++seq) {
+    TEST_CHECK(lanes->read_strict(&message, &lane));
+    TEST_CHECK_EQ(lane, 2);
+    TEST_CHECK_EQ(message.seq, seq);
+  }
+  TEST_CHECK(!lanes->read_strict(&message, &lane));
+}
+
+// reads count entries with read_weighted and checks the lane of each against expected
+static void check_weighted_order(Lanes& lanes, const unsigned* expected, unsigned count) {
+  LaneMessage message;
+  unsigned lane;
+  for (unsigned i = 0; i < count; ++i) {
+    TEST_CHECK(lanes.read_weighted(&message, &lane));
+    TEST_CHECK_EQ(lane, expected[i]);
+    TEST_CHECK_EQ(message.lane, expected[i]);
+  }
+}
+
+static void check_weighted() {
+  std::unique_ptr<Lanes> lanes(new Lanes());
+  lanes->weights[0] = 3;
+  lanes->weights[1] = 1;
+  lanes->weights[2] = 2;
+  for (unsigned lane = 0; lane < num_lanes; ++lane) { fill(*lanes, lane, lane_length); }
+
+  // the very first call already honours weights[0]
+  const unsigned expected[] = {0, 0, 0, 1, 2, 2, 0, 0, 0, 1, 2, 2};
+  check_weighted_order(*lanes, expected, sizeof(expected) / sizeof(expected[0]));
+}
+
+static void check_weighted_skips_empty() {
+  std::unique_ptr<Lanes> lanes(new Lanes());
+  LaneMessage message;
+  unsigned lane;
+  for (unsigned& weight : lanes->weights) { weight = 2; }
+  TEST_CHECK(!lanes->read_weighted(&message, &lane));
+
+  // lane 0 stays empty and lane 2 holds a single entry, so lane 1 gets every other turn
+  fill(*lanes, 1, 8);
+  fill(*lanes, 2, 1);
+  const unsigned expected[] = {1, 1, 2, 1, 1, 1, 1, 1, 1};
+  check_weighted_order(*lanes, expected, sizeof(expected) / sizeof(expected[0]));
+  TEST_CHECK(!lanes->read_weighted(&message, &lane));
+}
+
+int main() {
+  check_strict();
+  check_weighted();
+  check_weighted_skips_empty();
+  std::printf("test_priority_lanes: ok\n");
+  return 0;
+}
@@ -0,0 +1,93 @@
+/* RingBuf::read_batch() with RING_BUF_DENSE_STAMPS: partial batches stop at what is written or at
+max_count, batches that cross the wrap point come out whole, and a dense stamp that lags its slot
+(or runs ahead of it) only shortens the batch, never delivers a wrong or missing entry.
+  g++ -std=c++17 -O2 -pthread test_read_batch.cpp -o test_read_batch
+  g++ -std=c++17 -O2 -pthread -DRING_TEST_MPSC test_read_batch.cpp -o test_read_batch_mpsc
+*/
+#ifdef RING_TEST_MPSC
+#include "mpsc.cpp"
+#else
+#include "spsc.cpp"
+#endif
+#include "test.hpp"
+#include <memory>
+
+struct Message {
+  uint64_t value;
+};
+
+static constexpr unsigned ring_length = 16;
+
+using Ring = RingBuf<Message, ring_length, 4, RING_BUF_DENSE_STAMPS>;
+
+static void write_values(Ring& ring, uint64_t first, uint64_t last) {
+  for (uint64_t value = first; value <= last; ++value) {
+    Message message{value};
+    ring.write(&message);
+  }
+}
+
+// reads a batch of up to max_count and checks that it holds count entries with values from first on
+static void check_batch(Ring& ring, unsigned max_count, uint64_t first, unsigned count) {
+  Message batch[ring_length];
+  TEST_CHECK_EQ(ring.read_batch(batch, max_count), count);
+  for (unsigned i = 0; i < count; ++i) { TEST_CHECK_EQ(batch[i].value, first + i); }
+}
+
+static void check_partial_batches() {
+  std::unique_ptr<Ring> ring(new Ring());
+  check_batch(*ring, ring_length, 0, 0);
+  write_values(*ring, 1, 3);
+  check_batch(*ring, ring_length, 1, 3); // fewer written than asked for
+  check_batch(*ring, ring_length, 0, 0);
+  write_values(*ring, 4, 13);
+  check_batch(*ring, 5, 4, 5); // max_count: one vector compare and a one-by-one tail
+  check_batch(*ring, 4, 9, 4);
+  check_batch(*ring, ring_length, 13, 1);
+  TEST_CHECK_EQ(ring->read_sequence_number, 13);
+}
+
+static void check_wrap() {
+  std::unique_ptr<Ring> ring(new Ring());
+  for (uint64_t lap = 0; lap < 4; ++lap) { // reader positions 0, 13, 26 and 39: three of them mid-line near the wrap
+    const uint64_t first = lap * 13 + 1;
+    write_values(*ring, first, first + 12);
+    check_batch(*ring, ring_length, first, 13);
+  }
+  write_values(*ring, 53, 68); // exactly a full ring, starting at index 4
+  check_batch(*ring, ring_length, 53, ring_length);
+}
+
+static void check_lagging_stamps() {
+  std::unique_ptr<Ring> ring(new Ring());
+  write_values(*ring, 1, 12);
+  TEST_CHECK_EQ(ring->ready_count(0, ring_length), 12);
+
+  // the slot of 6 is written but its dense stamp still shows the previous lap
+  ring->dense_sequence_numbers[5] = 0;
+  TEST_CHECK_EQ(ring->ready_count(0, ring_length), 5);
+  check_batch(*ring, ring_length, 1, 5);
+  check_batch(*ring, ring_length, 6, 0); // a hint only: the batch ends although 6 is there
+  Message message{};
+  TEST_CHECK(ring->read(&message)); // and read() still gets it
+  TEST_CHECK_EQ(message.value, 6);
+  ring->dense_sequence_numbers[5] = 6;
+  check_batch(*ring, ring_length, 7, 6);
+
+  // a dense stamp ahead of its slot: read() checks the slot itself, so the batch ends there
+  write_values(*ring, 13, 14);
+  ring->dense_sequence_numbers[14] = 15;
+  ring->dense_sequence_numbers[15] = 16;
+  TEST_CHECK_EQ(ring->ready_count(12, ring_length), 4);
+  check_batch(*ring, ring_length, 13, 2);
+  write_values(*ring, 15, 16);
+  check_batch(*ring, ring_length, 15, 2);
+}
+
+int main() {
+  check_partial_batches();
+  check_wrap();
+  check_lagging_stamps();
+  std::printf("test_read_batch (" RING_TEST_IMPL "): ok\n");
+  return 0;
+}
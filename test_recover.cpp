@@ -0,0 +1,91 @@
+/* RingBuf::recover() after writers died mid-write, simulated with reserve() calls that are never
+committed: only the torn slots may be invalidated, every committed entry must survive, and the
+ring must take new writes afterwards.
+  g++ -std=c++17 -O2 -pthread test_recover.cpp -o test_recover
+  g++ -std=c++17 -O2 -pthread -DRING_TEST_MPSC test_recover.cpp -o test_recover_mpsc
+*/
+#ifdef RING_TEST_MPSC
+#include "mpsc.cpp"
+#else
+#include "spsc.cpp"
+#endif
+#include "test.hpp"
+
+struct Message {
+  uint64_t value;
+  uint64_t check; // ~value, so that a torn entry shows
+};
+
+template<typename Ring>
+static void write_value(Ring& ring, uint64_t value) {
+  Message message{value, ~value};
+  ring.write(&message);
+}
+
+template<typename Ring>
+static void check_read(Ring& ring, uint64_t value) {
+  Message message{};
+  TEST_CHECK(ring.read(&message));
+  TEST_CHECK_EQ(message.value, value);
+  TEST_CHECK_EQ(message.check, ~value);
+}
+
+template<unsigned version_granularity>
+static void check_recover(bool torn_stamped) {
+  using Ring = RingBuf<Message, 16, version_granularity>;
+  Ring ring;
+  for (uint64_t value = 1; value <= 5; ++value) { write_value(ring, value); }
+  check_read(ring, 1);
+
+  // a writer that died halfway through its entry
+  typename Ring::Reservation torn = ring.reserve();
+  torn.data->value = 6;
+#ifdef RING_TEST_MPSC
+  (void)torn_stamped; // MPSC stamps last
+  // a second writer that completed and stamped its entry but died before releasing the region
+  typename Ring::Reservation complete = ring.reserve();
+  *complete.data = Message{7, ~uint64_t(7)};
+  ring.buf[(complete.sequence_number - 1) & 15].sequence_number = (typename Ring::stamp_t)complete.sequence_number;
+  // and a third one that died before writing anything
+  ring.reserve();
+  TEST_CHECK_EQ(ring.recover(), 7);
+#else
+  if (torn_stamped) { // SPSC copies the stamp with the entry, so it may land before the rest
+    ring.buf[(torn.sequence_number - 1) & 15].sequence_number = (typename Ring::stamp_t)torn.sequence_number;
+  }
+  TEST_CHECK_EQ(ring.recover(), 5);
+#endif
+
+  for (uint64_t value = 2; value <= 5; ++value) { check_read(ring, value); }
+  Message message{};
+  TEST_CHECK(!ring.read(&message)); // the torn entry reads as unwritten
+#ifdef RING_TEST_MPSC
+  TEST_CHECK_EQ(ring.peek(7, &message), 7);
+  TEST_CHECK_EQ(message.value, 7);
+  TEST_CHECK_EQ(message.check, ~uint64_t(7));
+  TEST_CHECK(ring.seek(7));
+  check_read(ring, 7);
+  write_value(ring, 8);
+  check_read(ring, 8);
+#else
+  write_value(ring, 6);
+  check_read(ring, 6);
+#endif
+  for (unsigned version_idx = 0; version_idx < version_granularity; ++version_idx) {
+#ifdef RING_TEST_MPSC
+    TEST_CHECK_EQ((uint32_t)ring.version_numbers[version_idx].number.load(), 0); // every region released
+#else
+    TEST_CHECK_EQ(ring.version_numbers[version_idx].number.load() & 1, 0);
+#endif
+  }
+}
+
+int main() {
+  for (bool torn_stamped : {false, true}) {
+    check_recover<1>(torn_stamped);
+    check_recover<4>(torn_stamped);
+    check_recover<16>(torn_stamped);
+  }
+  std::printf("test_recover (" RING_TEST_IMPL "): ok\n");
+  return 0;
+}
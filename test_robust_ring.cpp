@@ -0,0 +1,110 @@
+/* RobustRing: a producer process killed in the middle of a write, with its region held and its
+sequence number claimed, does not wedge the reader. The reader reaps it, skips the abandoned
+entry, counts it in abandoned_entries and goes on reading what the live producers wrote. Opening
+the shared object as a ring of another shape with the same sizes fails.
+  g++ -std=c++17 -O2 -pthread test_robust_ring.cpp -o test_robust_ring
+*/
+#include "mpsc.cpp"
+#include "robust_ring.hpp"
+#include "test.hpp"
+#include <string>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+
+struct Message {
+  uint64_t value;
+  uint64_t producer_pid;
+};
+
+struct OtherMessage { // same size as Message
+  uint64_t count;
+  uint64_t total;
+};
+
+using Shared = SharedRobustRing<Message, 16, 4>;
+
+static void write_value(Shared::Robust& ring, int producer, uint64_t value) {
+  Message message{value, (uint64_t)getpid()};
+  ring.write(producer, &message);
+}
+
+static void check_read(Shared::Robust& ring, uint64_t value) {
+  Message message{};
+  TEST_CHECK(ring.read(&message));
+  TEST_CHECK_EQ(message.value, value);
+}
+
+// the forked producer: one complete write, then dies holding the region of the next one
+static void producer_main(const char* name, int ready_fd) {
+  prctl(PR_SET_PDEATHSIG, SIGKILL); // not left behind if a check fails in the parent
+  Shared shared;
+  if (!shared.open(name)) { _exit(2); }
+  const int producer = shared.ring->attach();
+  if (producer < 0) { _exit(3); }
+  write_value(*shared.ring, producer, 2);
+
+  // RobustRing::write() up to the copy: the sequence number is claimed and recorded in the lease
+  const Shared::Robust::Ring::Claim claimed = shared.ring->ring.claim(uint64_t(1) << producer, std::memory_order_release);
+  shared.ring->leases[producer].claimed_sequence_number.store(claimed.sequence_number, std::memory_order_relaxed);
+  const char ready = (char)claimed.sequence_number;
+  if (write(ready_fd, &ready, 1) != 1) { _exit(4); }
+  for (;;) { pause(); } // killed here
+}
+
+int main() {
+  const std::string name = "/ring_buf_test_robust_" + std::to_string(getpid());
+  Shared::unlink(name.c_str()); // left over from an earlier run that crashed
+  Shared shared;
+  TEST_CHECK(shared.open(name.c_str()));
+  Shared::Robust& ring = *shared.ring;
+  const int producer = ring.attach();
+  TEST_CHECK(producer >= 0);
+  write_value(ring, producer, 1);
+
+  int ready_pipe[2];
+  TEST_CHECK(!pipe(ready_pipe));
+  const pid_t child = fork();
+  TEST_CHECK(child >= 0);
+  if (!child) { producer_main(name.c_str(), ready_pipe[1]); }
+  char claimed = 0;
+  TEST_CHECK_EQ(read(ready_pipe[0], &claimed, 1), 1);
+  TEST_CHECK_EQ(claimed, 3);
+  write_value(ring, producer, 4); // claimed after the dead producer's entry, in another region
+
+  check_read(ring, 1);
+  check_read(ring, 2);
+  TEST_CHECK(!kill(child, SIGKILL));
+  int status = 0;
+  TEST_CHECK_EQ(waitpid(child, &status, 0), child);
+  TEST_CHECK(WIFSIGNALED(status) && WTERMSIG(status) == SIGKILL);
+
+  check_read(ring, 4); // spins on the held region, reaps the producer and skips entry 3
+  TEST_CHECK_EQ(ring.abandoned_entries, 1);
+  TEST_CHECK_EQ(ring.reaped_producers.load(), 1);
+  Message message{};
+  TEST_CHECK(!ring.read(&message));
+
+  // the dead producer's lease is free again and the ring goes on as before
+  const int second = ring.attach();
+  TEST_CHECK(second >= 0);
+  for (uint64_t value = 5; value <= 40; ++value) {
+    write_value(ring, value & 1 ? producer : second, value);
+    check_read(ring, value);
+  }
+  TEST_CHECK(!ring.read(&message));
+  TEST_CHECK_EQ(ring.abandoned_entries, 1);
+
+  SharedRobustRing<OtherMessage, 16, 4> other_type;
+  static_assert(sizeof(SharedRobustRing<OtherMessage, 16, 4>::Robust) == sizeof(Shared::Robust), "");
+  TEST_CHECK(!other_type.open(name.c_str()));
+  TEST_CHECK_EQ(errno, EINVAL);
+  SharedRobustRing<Message, 16, 4, RING_BUF_STAMP32> other_stamp;
+  static_assert(sizeof(SharedRobustRing<Message, 16, 4, RING_BUF_STAMP32>::Robust) == sizeof(Shared::Robust), "");
+  TEST_CHECK(!other_stamp.open(name.c_str()));
+  TEST_CHECK_EQ(errno, EINVAL);
+
+  shared.close();
+  TEST_CHECK(Shared::unlink(name.c_str()));
+  std::printf("test_robust_ring: ok\n");
+  return 0;
+}
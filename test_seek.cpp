@@ -0,0 +1,66 @@
+/* RingBuf::seek(): sequence number 0, overwritten entries and entries beyond the one after the
+newest are refused without moving the reader, the entry after the newest one is a valid target,
+and the intact count stops at the first entry that is not committed.
+  g++ -std=c++17 -O2 -pthread test_seek.cpp -o test_seek
+  g++ -std=c++17 -O2 -pthread -DRING_TEST_MPSC test_seek.cpp -o test_seek_mpsc
+*/
+#ifdef RING_TEST_MPSC
+#include "mpsc.cpp"
+#else
+#include "spsc.cpp"
+#endif
+#include "test.hpp"
+
+struct Message {
+  uint64_t value;
+};
+
+template<typename Ring>
+static void check_read(Ring& ring, uint64_t value) {
+  Message message{};
+  TEST_CHECK(ring.read(&message));
+  TEST_CHECK_EQ(message.value, value);
+}
+
+template<unsigned flags>
+static void check_seek() {
+  using Ring = RingBuf<Message, 8, 2, flags>;
+  Ring ring;
+  for (uint64_t value = 1; value <= 12; ++value) { // 5..12 are retained
+    Message message{value};
+    ring.write(&message);
+  }
+
+  uint64_t intact = UINT64_MAX;
+  TEST_CHECK(!ring.seek(0, &intact));
+  TEST_CHECK(!ring.seek(4, &intact)); // overwritten by 12
+  TEST_CHECK(!ring.seek(14, &intact)); // past the head: would skip 13
+  TEST_CHECK(!ring.seek(UINT64_MAX, &intact));
+  TEST_CHECK_EQ(intact, UINT64_MAX);
+  TEST_CHECK_EQ(ring.read_sequence_number, 0); // the reader did not move
+
+  TEST_CHECK(ring.seek(5, &intact));
+  TEST_CHECK_EQ(intact, 8);
+  check_read(ring, 5);
+
+  TEST_CHECK(ring.seek(13, &intact)); // the head: nothing to read yet, but not a failure
+  TEST_CHECK_EQ(intact, 0);
+  Message message{};
+  TEST_CHECK(!ring.read(&message));
+  message.value = 13;
+  ring.write(&message);
+  check_read(ring, 13);
+
+  TEST_CHECK(ring.seek(10, &intact));
+  TEST_CHECK_EQ(intact, 4);
+  for (uint64_t value = 10; value <= 13; ++value) { check_read(ring, value); }
+  TEST_CHECK(ring.seek(11));
+  check_read(ring, 11);
+}
+
+int main() {
+  check_seek<0>();
+  check_seek<RING_BUF_STAMP16>();
+  std::printf("test_seek (" RING_TEST_IMPL "): ok\n");
+  return 0;
+}
@@ -0,0 +1,65 @@
+/* Regression test for torn reads: a write that starts and finishes while read() copies the same
+slot must make read() copy again. Before the version number was also checked before the copy
+(and, for MPSC, before it counted completed writes), read() only looked at it afterwards, saw
+a region that was not being written at that moment and returned half of one entry and half of
+the next.
+
+Entries are large and every word of one holds the same value, so a torn copy shows up as mixed
+words. The ring is tiny and has a single version region so that writers keep overwriting the slot
+the reader is copying; with one CPU the scheduler does the interleaving (a preempted copy resumes
+after the writer ran for a whole time slice).
+  g++ -std=c++17 -O2 -pthread test_torn_read.cpp -o test_torn_read
+  g++ -std=c++17 -O2 -pthread -DRING_TEST_MPSC test_torn_read.cpp -o test_torn_read_mpsc
+*/
+#ifdef RING_TEST_MPSC
+#include "mpsc.cpp"
+#else
+#include "spsc.cpp"
+#endif
+#include "test.hpp"
+#include <chrono>
+#include <memory>
+#include <thread>
+
+static constexpr unsigned entry_words = 8192;
+
+struct WideEntry {
+  uint64_t words[entry_words]; // 64 KiB, so that a copy is often preempted
+};
+
+int main() {
+  using Ring = RingBuf<WideEntry, 4, 1>;
+  std::unique_ptr<Ring> ring(new Ring());
+#ifdef RING_TEST_MPSC
+  const unsigned writers = 2;
+#else
+  const unsigned writers = 1;
+#endif
+  std::atomic<bool> stop{false};
+  std::thread writer_threads[2];
+  for (unsigned writer = 0; writer < writers; ++writer) {
+    writer_threads[writer] = std::thread([&, writer] {
+      std::unique_ptr<WideEntry> entry(new WideEntry());
+      for (uint64_t value = writer + 1; !stop.load(std::memory_order_relaxed); value += writers) {
+        std::fill(entry->words, entry->words + entry_words, value);
+        ring->write(entry.get());
+      }
+    });
+  }
+
+  std::unique_ptr<WideEntry> entry(new WideEntry());
+  uint64_t reads = 0, torn = 0;
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(500);
+  while (std::chrono::steady_clock::now() < deadline) {
+    if (!ring->read(entry.get())) { continue; }
+    ++reads;
+    torn += std::any_of(entry->words, entry->words + entry_words, [&](uint64_t word) { return word != entry->words[0]; });
+  }
+  stop.store(true, std::memory_order_relaxed);
+  for (unsigned writer = 0; writer < writers; ++writer) { writer_threads[writer].join(); }
+
+  std::printf("test_torn_read (" RING_TEST_IMPL "): %lu reads, %lu torn\n", (unsigned long)reads, (unsigned long)torn);
+  TEST_CHECK(reads > 0);
+  TEST_CHECK_EQ(torn, 0);
+  return 0;
+}
@@ -0,0 +1,154 @@
+/* TypedChannel: messages of different types come out in exactly the order they were written,
+through the handler for their type, including when one type runs ahead of the others, and a
+message that is due but not written yet holds back the later ones of other types. A lapped
+sub-ring does not wedge the channel: the overwritten messages are skipped and counted, and the
+leftovers the sub-ring hands out afterwards are dropped. SPSC only, like TypedChannel itself.
+  g++ -std=c++17 -O2 -pthread test_typed_channel.cpp -o test_typed_channel
+*/
+#include "spsc.cpp"
+#include "typed_channel.hpp"
+#include "test.hpp"
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+struct Small {
+  uint32_t order;
+};
+
+struct Medium {
+  uint64_t order;
+  uint64_t payload[3];
+};
+
+struct Large {
+  uint64_t order;
+  char name[100];
+};
+
+using Channel = TypedChannel<16, Small, Medium, Large>;
+
+// the type of the message with the given order: an irregular pattern with runs of each type
+static unsigned type_of(uint64_t order) { return (order * 7 + order / 5) % 3; }
+
+static void write_message(Channel& channel, uint64_t order) {
+  switch (type_of(order)) {
+    case 0: channel.write(Small{(uint32_t)order}); break;
+    case 1: channel.write(Medium{order, {order, order, order}}); break;
+    default: {
+      Large large{order, {}};
+      std::snprintf(large.name, sizeof(large.name), "large %llu", (unsigned long long)order);
+      channel.write(large);
+    }
+  }
+}
+
+// checks each message against the type and order expected next
+struct Checker {
+  uint64_t next = 0;
+  void operator()(const Small& message) { check(0, message.order); }
+  void operator()(const Medium& message) {
+    check(1, message.order);
+    TEST_CHECK_EQ(message.payload[2], message.order);
+  }
+  void operator()(const Large& message) {
+    check(2, message.order);
+    char name[100];
+    std::snprintf(name, sizeof(name), "large %llu", (unsigned long long)message.order);
+    TEST_CHECK(!std::strcmp(message.name, name));
+  }
+  void check(unsigned type, uint64_t order) {
+    TEST_CHECK_EQ(order, next);
+    TEST_CHECK_EQ(type, type_of(order));
+    ++next;
+  }
+};
+
+static void check_merge_order() {
+  std::unique_ptr<Channel> channel(new Channel());
+  Checker checker;
+  TEST_CHECK(!channel->read(checker));
+  for (uint64_t order = 0; order < 1000; order += 12) { // at most 12 of a type in flight, within length
+    for (uint64_t i = order; i < order + 12; ++i) { write_message(*channel, i); }
+    while (channel->read(checker)) {}
+    TEST_CHECK_EQ(checker.next, order + 12);
+  }
+
+  // a due Medium that is not written yet holds back Smalls written after it
+  std::vector<uint64_t> smalls;
+  auto record = TypedHandlers{
+    [&](const Small& message) { smalls.push_back(message.order); },
+    [&](const Medium& message) { smalls.push_back(UINT64_MAX - message.order); },
+    [&](const Large&) { TEST_CHECK(false); },
+  };
+  const uint64_t due = channel->channel_sequence_number;
+  channel->channel_sequence_number = due + 1; // as if the Medium numbered due were still being written
+  channel->write(Small{(uint32_t)(due + 1)});
+  channel->write(Small{(uint32_t)(due + 2)});
+  TEST_CHECK(!channel->read(record));
+  TEST_CHECK(smalls.empty());
+  Channel::__sequenced<Medium> late{due, Medium{due, {}}};
+  std::get<1>(channel->rings).write(&late);
+  while (channel->read(record)) {}
+  TEST_CHECK_EQ(smalls.size(), 3);
+  TEST_CHECK_EQ(smalls[0], UINT64_MAX - due);
+  TEST_CHECK_EQ(smalls[1], due + 1);
+  TEST_CHECK_EQ(smalls[2], due + 2);
+}
+
+static void check_lapped_sub_ring() {
+  std::unique_ptr<Channel> channel(new Channel());
+  std::vector<uint64_t> orders;
+  auto record = TypedHandlers{
+    [&](const Small& message) { orders.push_back(message.order); },
+    [&](const Medium& message) { orders.push_back(message.order); },
+    [&](const Large& message) { orders.push_back(message.order); },
+  };
+  // laps the Small sub-ring: 0 to 3 are overwritten, and since its first slot now holds 16, 4 to 15
+  // come out only after 16 to 19 and are dropped
+  for (uint32_t order = 0; order < 20; ++order) { channel->write(Small{order}); }
+  channel->write(Medium{20, {}});
+  while (channel->read(record) || channel->read(record)) {} // the first failing read may have found a new head
+  TEST_CHECK((orders == std::vector<uint64_t>{16, 17, 18, 19, 20}));
+  TEST_CHECK_EQ(channel->lost_messages, 16);
+
+  // back to normal: a sub-ring that caught up delivers in order again
+  orders.clear();
+  channel->write(Small{21});
+  channel->write(Large{22, {}});
+  channel->write(Small{23});
+  while (channel->read(record)) {}
+  TEST_CHECK((orders == std::vector<uint64_t>{21, 22, 23}));
+  TEST_CHECK_EQ(channel->lost_messages, 16);
+}
+
+static void check_concurrent_producer() {
+  std::unique_ptr<Channel> channel(new Channel());
+  const uint64_t total = 200000;
+  std::atomic<uint64_t> consumed{0};
+  std::thread producer([&] {
+    for (uint64_t order = 0; order < total; ++order) {
+      while (order - consumed.load(std::memory_order_acquire) >= 8) { std::this_thread::yield(); }
+      write_message(*channel, order);
+    }
+  });
+  Checker checker;
+  while (checker.next < total) {
+    if (channel->read(checker)) {
+      consumed.store(checker.next, std::memory_order_release);
+    } else {
+      std::this_thread::yield();
+    }
+  }
+  producer.join();
+  TEST_CHECK(!channel->read(checker));
+}
+
+int main() {
+  check_merge_order();
+  check_lapped_sub_ring();
+  check_concurrent_producer();
+  std::printf("test_typed_channel: ok\n");
+  return 0;
+}
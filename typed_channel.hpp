@@ -0,0 +1,118 @@
+#pragma once
+#include <tuple>
+#include <utility>
+#include "ring_buf.hpp"
+
+/* Channel for a closed set of message types that routes each type into its own RingBuf, so every
+slot is sized for its type instead of for the largest one. All sub-rings share one channel-wide
+sequence number, and the consumer merges them back into exactly the order in which they were
+written. Handlers are resolved at compile time: read() calls handler(const Message&) for the
+message's static type, so an overload set (see TypedHandlers) dispatches without virtual calls.
+
+The channel sequence number is assigned by the producer, so a TypedChannel has a single producer
+(include spsc.cpp); with several producers a message could be numbered before another one that
+overtakes it in the same sub-ring, and the merge would stall. Use one channel per producer instead.
+
+As with RingBuf, the producer is not held back by the consumer. If it laps a sub-ring, the
+messages it overwrote never arrive: once a read() has polled every sub-ring without finding the
+due message or any new head, the consumer skips to the smallest head and adds the skipped channel
+sequence numbers to lost_messages. Older entries that the lapped sub-ring still hands out
+afterwards are dropped.
+*/
+template<unsigned length, typename... Messages>
+struct TypedChannel {
+  static_assert(sizeof...(Messages), "a channel needs at least one message type");
+
+  template<typename Message, typename... Others>
+  static constexpr unsigned index_of() {
+    unsigned index = 0;
+    bool found = false;
+    ((found = found || std::is_same_v<Message, Others>, index += !found), ...);
+    return found ? index : sizeof...(Others);
+  }
+  template<typename Message>
+  static constexpr unsigned count_of() { return (0u + ... + (unsigned)std::is_same_v<Message, Messages>); }
+  static_assert(((count_of<Messages>() == 1) && ...), "message types must be distinct");
+
+  template<typename Message>
+  struct __sequenced {
+    uint64_t channel_sequence_number;
+    Message message;
+  };
+
+  std::tuple<RingBuf<__sequenced<Messages>, length>...> rings;
+  uint64_t channel_sequence_number; // producer only
+
+  // consumer only: the head of each sub-ring, read ahead while another type's message is due
+  std::tuple<__sequenced<Messages>...> heads;
+  bool head_valid[sizeof...(Messages)];
+  uint64_t next_channel_sequence_number;
+  uint64_t heads_read; // sub-ring reads so far, so that read() can tell whether a pass found a new head
+  uint64_t lost_messages; // channel sequence numbers skipped because their sub-ring was lapped
+
+  template<typename Message>
+  void write(const Message& message) {
+    constexpr unsigned index = index_of<Message, Messages...>();
+    static_assert(index < sizeof...(Messages), "Message is not one of the channel's message types");
+    __sequenced<Message> entry{channel_sequence_number++, message};
+    std::get<index>(rings).write(&entry);
+  }
+
+  // Returns whether the next message in channel order was available and handled.
+  template<typename Handler>
+  bool read(Handler&& handler) {
+    const uint64_t heads_before = heads_read;
+    if (read_any(handler, std::index_sequence_for<Messages...>{})) { return true; }
+    /* Every sub-ring without a head was just polled, after the current heads were read. With a
+    single producer, everything numbered below the smallest head was written before it and would
+    have shown up, so if no new head did either, the due message was overwritten.
+    */
+    if (heads_read != heads_before) { return false; }
+    const uint64_t smallest = smallest_head(std::index_sequence_for<Messages...>{});
+    if (smallest == UINT64_MAX || smallest <= next_channel_sequence_number) { return false; }
+    lost_messages += smallest - next_channel_sequence_number;
+    next_channel_sequence_number = smallest;
+    return read_any(handler, std::index_sequence_for<Messages...>{});
+  }
+
+  template<typename Handler, size_t... indices>
+  bool read_any(Handler& handler, std::index_sequence<indices...>) {
+    return (deliver_if_next<indices>(handler) || ...);
+  }
+
+  template<size_t... indices>
+  uint64_t smallest_head(std::index_sequence<indices...>) const {
+    uint64_t smallest = UINT64_MAX;
+    ((smallest = head_valid[indices] ? std::min(smallest, std::get<indices>(heads).channel_sequence_number) : smallest), ...);
+    return smallest;
+  }
+
+  template<size_t index, typename Handler>
+  bool deliver_if_next(Handler& handler) {
+    auto& head = std::get<index>(heads);
+    // a head below the next number is a leftover of a lapped sub-ring, already counted as lost
+    while (!head_valid[index] || head.channel_sequence_number < next_channel_sequence_number) {
+      head_valid[index] = false;
+      if (!std::get<index>(rings).read(&head)) { return false; }
+      head_valid[index] = true;
+      ++heads_read;
+    }
+    if (head.channel_sequence_number != next_channel_sequence_number) { return false; }
+    head_valid[index] = false;
+    ++next_channel_sequence_number;
+    handler(static_cast<const decltype(head.message)&>(head.message));
+    return true;
+  }
+
+  TypedChannel() : channel_sequence_number(0), heads(), next_channel_sequence_number(0), heads_read(0), lost_messages(0) {
+    for (bool& valid : head_valid) { valid = false; }
+  }
+};
+
+// TypedHandlers{[](const A&) {...}, [](const B&) {...}} builds one overload set from several lambdas
+template<typename... Handlers>
+struct TypedHandlers : Handlers... {
+  using Handlers::operator()...;
+};
+template<typename... Handlers>
+TypedHandlers(Handlers...) -> TypedHandlers<Handlers...>;